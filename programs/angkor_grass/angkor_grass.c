@@ -22,7 +22,9 @@
  * SOFTWARE.
  */
 
+#include "anim.h"
 #include "chunk.h"
+#include "engine_tex_impl.h"
 #include "graphic.h"
 #include "sprite.h"
 
@@ -36,7 +38,7 @@ sprite_t* grass = NULL;
 sprite_t* bg_spr = NULL;
 
 int anim_flip = 0;
-int frames_count = 0;
+anim_player_t grass_anim;
 
 SDL_bool running = SDL_TRUE;
 
@@ -54,10 +56,11 @@ void draw_background()
 void draw_animation()
 {
     if (anim_flip > FLIP_XY)
-        sprite_draw_aframe(grass, frames_count, 24, 24, anim_flip - FLIP_XY - 1);
+        anim_player_draw(&grass_anim, 24, 24, anim_flip - FLIP_XY - 1);
     else
-        sprite_draw_aframe_abs(grass, frames_count, 24, 24, anim_flip);
-    frames_count = (frames_count + 1) % 8;
+        sprite_draw_aframe_abs(grass, anim_player_get_aframe(&grass_anim), 24, 24, anim_flip);
+    // one tick per rendered frame
+    anim_player_update(&grass_anim, 1);
     return;
 }
 
@@ -99,6 +102,7 @@ int texture_init()
     }
     chunk_free(chunk);
 
+    anim_player_init(&grass_anim, grass, 0, ANIM_LOOP_FOREVER);
     return 0;
 }
 
@@ -132,8 +136,11 @@ void main_loop()
     }
 #endif
 
+    module_batch_begin(graphic_render);
     draw_background();
+    module_batch_layer(1, graphic_render);
     draw_animation();
+    module_batch_end(graphic_render);
 
     graphic_present();
 
@@ -172,6 +179,8 @@ int main()
 release_res:
     sprite_free(bg_spr);
     sprite_free(grass);
+    sprite_free_scratch();
+    module_batch_release(graphic_render);
     graphic_quit();
     return 0;
 }
@@ -25,74 +25,946 @@
 #include "engine_tex_impl.h"
 
 #include <SDL2/SDL.h>
+#include <string.h> /* memset */
 
 #define FLIP_NONE 0
 #define FLIP_X 1
 #define FLIP_Y 2
 #define FLIP_XY (FLIP_X|FLIP_Y)
 
-void* module_new(void* pixels, int w, int h, void* user_data)
+// private struct
+typedef struct tex_module_s {
+    SDL_Texture* texture;
+    SDL_Rect rect; // region of texture this module covers
+    int tex_w;     // size of the whole texture, for batch uv
+    int tex_h;
+    int texel_size; // bytes per texel, for module_update
+    int owner;      // 0 for views created by module_sub
+} tex_module_t;
+
+typedef struct draw_cmd_s {
+    tex_module_t* tex;
+    const tex_prim_t* prim; // set instead of tex for shapes
+    int x;
+    int y;
+    int flip;
+    int layer;
+    int seq;  // record order, keeps the sort stable
+    int next; // next command of the same batch
+} draw_cmd_t;
+
+typedef struct draw_batch_s {
+    SDL_Texture* texture; // NULL for a batch of shapes
+    SDL_Rect bounds; // union of the batch quads
+    int first;
+    int last;
+} draw_batch_t;
+
+typedef struct draw_list_s {
+    int active;
+    SDL_Renderer* render; // the batch records for this one only
+    int layer;
+    int count;
+    int capacity;
+    draw_cmd_t* cmds;
+    draw_batch_t* batches;
+    int quad_capacity;
+    SDL_Vertex* vertices;
+    int* indices;
+    // modules freed while recorded, freed for real once submitted
+    int free_count;
+    int free_capacity;
+    tex_module_t** frees;
+} draw_list_t;
+
+// how many batches a draw may look back to find its texture
+#define DRAW_BATCH_LOOKBACK 32
+
+// most segments an arc is made of
+#define PRIM_ARC_SEGMENTS 64
+
+// private data
+static draw_list_t draw_list = { 0 };
+
+// private functions
+static void paint_now(SDL_Renderer* render, tex_module_t* tex, int x, int y, int flip)
+{
+    double rotate;
+    SDL_Rect real_rect;
+    SDL_RendererFlip real_flip;
+
+    rotate = 0;
+    real_flip = SDL_FLIP_NONE;
+    real_rect.x = x;
+    real_rect.y = y;
+    real_rect.w = tex->rect.w;
+    real_rect.h = tex->rect.h;
+    switch (flip & FLIP_XY) {
+    case FLIP_Y:
+        rotate = 180;
+    case FLIP_X:
+        real_flip = SDL_FLIP_HORIZONTAL;
+        break;
+    case FLIP_XY:
+        rotate = 180;
+        break;
+    }
+
+    SDL_RenderCopyEx(render, tex->texture, &tex->rect, &real_rect, rotate, NULL, real_flip);
+    return;
+}
+
+// fans of triangles from the center of the box, outlines are lines
+// through the same points
+static void prim_arc_now(SDL_Renderer* render, const tex_prim_t* prim, int x, int y, int flip)
+{
+    int n;
+    int start, arc;
+    float cx, cy, rx, ry;
+    float angle;
+    float dir_x, dir_y;
+    SDL_Color color;
+    SDL_FPoint points[PRIM_ARC_SEGMENTS + 1];
+    SDL_Vertex vertices[PRIM_ARC_SEGMENTS + 2];
+    int indices[PRIM_ARC_SEGMENTS * 3];
+
+    start = prim->start;
+    arc = prim->arc;
+    if (arc < 0) {
+        start += arc;
+        arc = -arc;
+    }
+    if (!arc)
+        return;
+    if (arc > 360)
+        arc = 360;
+
+    n = 4 + arc * (prim->w + prim->h) / 720;
+    if (n > PRIM_ARC_SEGMENTS)
+        n = PRIM_ARC_SEGMENTS;
+
+    // lines run through pixel centers, triangles cover the whole box
+    rx = prim->type == TEX_PRIM_ARC ? (prim->w - 1) * 0.5f : prim->w * 0.5f;
+    ry = prim->type == TEX_PRIM_ARC ? (prim->h - 1) * 0.5f : prim->h * 0.5f;
+    cx = x + (prim->type == TEX_PRIM_ARC ? rx : prim->w * 0.5f);
+    cy = y + (prim->type == TEX_PRIM_ARC ? ry : prim->h * 0.5f);
+    dir_x = (flip & FLIP_X) ? -rx : rx;
+    dir_y = (flip & FLIP_Y) ? ry : -ry;
+    for (int i = 0; i <= n; i++) {
+        angle = (start + (float)arc * i / n) * ((float)M_PI / 180.f);
+        points[i].x = cx + dir_x * SDL_cosf(angle);
+        points[i].y = cy + dir_y * SDL_sinf(angle);
+    }
+
+    if (prim->type == TEX_PRIM_ARC) {
+        SDL_RenderDrawLinesF(render, points, n + 1);
+        return;
+    }
+
+    color.r = (prim->color >> 16) & 0xFF;
+    color.g = (prim->color >> 8) & 0xFF;
+    color.b = prim->color & 0xFF;
+    color.a = prim->color >> 24;
+    vertices[0].position.x = cx;
+    vertices[0].position.y = cy;
+    for (int i = 0; i <= n; i++) {
+        vertices[i + 1].position = points[i];
+    }
+    for (int i = 0; i < n + 2; i++) {
+        vertices[i].color = color;
+        vertices[i].tex_coord.x = 0;
+        vertices[i].tex_coord.y = 0;
+    }
+    for (int i = 0; i < n; i++) {
+        indices[i * 3 + 0] = 0;
+        indices[i * 3 + 1] = i + 1;
+        indices[i * 3 + 2] = i + 2;
+    }
+    SDL_RenderGeometry(render, NULL, vertices, n + 2, indices, n * 3);
+    return;
+}
+
+static void prim_triangle_now(SDL_Renderer* render, const tex_prim_t* prim, int x, int y, int flip)
+{
+    SDL_Point points[4];
+    SDL_Vertex vertices[3];
+
+    for (int i = 0; i < 3; i++) {
+        points[i].x = x + ((flip & FLIP_X) ? prim->w - 1 - prim->x[i] : prim->x[i]);
+        points[i].y = y + ((flip & FLIP_Y) ? prim->h - 1 - prim->y[i] : prim->y[i]);
+    }
+    if (prim->type == TEX_PRIM_TRIANGLE) {
+        points[3] = points[0];
+        SDL_RenderDrawLines(render, points, 4);
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        vertices[i].position.x = points[i].x + 0.5f;
+        vertices[i].position.y = points[i].y + 0.5f;
+        vertices[i].color.r = (prim->color >> 16) & 0xFF;
+        vertices[i].color.g = (prim->color >> 8) & 0xFF;
+        vertices[i].color.b = prim->color & 0xFF;
+        vertices[i].color.a = prim->color >> 24;
+        vertices[i].tex_coord.x = 0;
+        vertices[i].tex_coord.y = 0;
+    }
+    SDL_RenderGeometry(render, NULL, vertices, 3, NULL, 0);
+    return;
+}
+
+// draws with the color of prim, the draw state of the caller is put back
+static void prim_now(SDL_Renderer* render, const tex_prim_t* prim, int x, int y, int flip)
+{
+    Uint8 r, g, b, a;
+    SDL_BlendMode blend;
+    SDL_Rect rect;
+
+    if (prim->w <= 0 || prim->h <= 0)
+        return;
+
+    SDL_GetRenderDrawColor(render, &r, &g, &b, &a);
+    SDL_GetRenderDrawBlendMode(render, &blend);
+    SDL_SetRenderDrawColor(render, (prim->color >> 16) & 0xFF, (prim->color >> 8) & 0xFF,
+        prim->color & 0xFF, prim->color >> 24);
+    SDL_SetRenderDrawBlendMode(render, (prim->color >> 24) == 0xFF ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+
+    rect.x = x;
+    rect.y = y;
+    rect.w = prim->w;
+    rect.h = prim->h;
+    switch (prim->type) {
+    case TEX_PRIM_RECT:
+        SDL_RenderDrawRect(render, &rect);
+        break;
+    case TEX_PRIM_FILL_RECT:
+        SDL_RenderFillRect(render, &rect);
+        break;
+    case TEX_PRIM_ARC:
+    case TEX_PRIM_FILL_ARC:
+        prim_arc_now(render, prim, x, y, flip);
+        break;
+    case TEX_PRIM_TRIANGLE:
+    case TEX_PRIM_FILL_TRIANGLE:
+        prim_triangle_now(render, prim, x, y, flip);
+        break;
+    }
+
+    SDL_SetRenderDrawBlendMode(render, blend);
+    SDL_SetRenderDrawColor(render, r, g, b, a);
+    return;
+}
+
+static void draw_cmd_now(SDL_Renderer* render, const draw_cmd_t* cmd)
+{
+    if (cmd->tex)
+        paint_now(render, cmd->tex, cmd->x, cmd->y, cmd->flip);
+    else
+        prim_now(render, cmd->prim, cmd->x, cmd->y, cmd->flip);
+    return;
+}
+
+static int draw_cmd_compare(const void* a, const void* b)
+{
+    const draw_cmd_t* ca;
+    const draw_cmd_t* cb;
+
+    ca = (const draw_cmd_t*)a;
+    cb = (const draw_cmd_t*)b;
+    if (ca->layer != cb->layer)
+        return ca->layer < cb->layer ? -1 : 1;
+
+    return ca->seq - cb->seq;
+}
+
+static int draw_list_reserve_quads(int count)
+{
+    int capacity;
+    int* indices;
+    SDL_Vertex* vertices;
+
+    if (count <= draw_list.quad_capacity)
+        return 0;
+
+    capacity = draw_list.quad_capacity ? draw_list.quad_capacity : 64;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    vertices = (SDL_Vertex*)realloc(draw_list.vertices, capacity * 4 * sizeof(SDL_Vertex));
+    if (!vertices)
+        return -1;
+    draw_list.vertices = vertices;
+
+    indices = (int*)realloc(draw_list.indices, capacity * 6 * sizeof(int));
+    if (!indices)
+        return -1;
+    draw_list.indices = indices;
+
+    // the index pattern never changes, batches are submitted from vertex 0
+    for (int i = draw_list.quad_capacity; i < capacity; i++) {
+        indices[i * 6 + 0] = i * 4 + 0;
+        indices[i * 6 + 1] = i * 4 + 1;
+        indices[i * 6 + 2] = i * 4 + 2;
+        indices[i * 6 + 3] = i * 4 + 2;
+        indices[i * 6 + 4] = i * 4 + 1;
+        indices[i * 6 + 5] = i * 4 + 3;
+    }
+    draw_list.quad_capacity = capacity;
+    return 0;
+}
+
+static void draw_cmd_quad(const draw_cmd_t* cmd, SDL_Vertex* v)
+{
+    float x0, y0, x1, y1;
+    float u0, v0, u1, v1;
+    float tmp;
+    tex_module_t* tex;
+    SDL_Color white = { 255, 255, 255, 255 };
+
+    tex = cmd->tex;
+    x0 = (float)cmd->x;
+    y0 = (float)cmd->y;
+    x1 = x0 + tex->rect.w;
+    y1 = y0 + tex->rect.h;
+    u0 = (float)tex->rect.x / tex->tex_w;
+    v0 = (float)tex->rect.y / tex->tex_h;
+    u1 = (float)(tex->rect.x + tex->rect.w) / tex->tex_w;
+    v1 = (float)(tex->rect.y + tex->rect.h) / tex->tex_h;
+
+    // same result as the rotate / flip pairs of paint_now
+    if (cmd->flip & FLIP_X) {
+        tmp = u0; u0 = u1; u1 = tmp;
+    }
+    if (cmd->flip & FLIP_Y) {
+        tmp = v0; v0 = v1; v1 = tmp;
+    }
+
+    // 0 top left, 1 top right, 2 bottom left, 3 bottom right
+    v[0].position.x = x0; v[0].position.y = y0;
+    v[0].tex_coord.x = u0; v[0].tex_coord.y = v0;
+    v[1].position.x = x1; v[1].position.y = y0;
+    v[1].tex_coord.x = u1; v[1].tex_coord.y = v0;
+    v[2].position.x = x0; v[2].position.y = y1;
+    v[2].tex_coord.x = u0; v[2].tex_coord.y = v1;
+    v[3].position.x = x1; v[3].position.y = y1;
+    v[3].tex_coord.x = u1; v[3].tex_coord.y = v1;
+    for (int i = 0; i < 4; i++) {
+        v[i].color = white;
+    }
+    return;
+}
+
+// groups cmds into batches without changing what ends on top: a draw may
+// join an earlier batch of its texture only if no draw in between overlaps it
+static int draw_list_group(void)
+{
+    int batch_count;
+    int found;
+    SDL_Rect rect;
+    SDL_Texture* texture;
+    draw_cmd_t* cmd;
+    draw_batch_t* batch;
+
+    batch_count = 0;
+    for (int i = 0; i < draw_list.count; i++) {
+        cmd = &draw_list.cmds[i];
+        cmd->next = -1;
+        rect.x = cmd->x;
+        rect.y = cmd->y;
+        rect.w = cmd->tex ? cmd->tex->rect.w : cmd->prim->w;
+        rect.h = cmd->tex ? cmd->tex->rect.h : cmd->prim->h;
+        texture = cmd->tex ? cmd->tex->texture : NULL;
+
+        found = -1;
+        for (int j = batch_count - 1; j >= 0 && j >= batch_count - DRAW_BATCH_LOOKBACK; j--) {
+            batch = &draw_list.batches[j];
+            if (batch->texture == texture) {
+                found = j;
+                break;
+            }
+            if (SDL_HasIntersection(&batch->bounds, &rect))
+                break;
+        }
+
+        if (found < 0) {
+            batch = &draw_list.batches[batch_count++];
+            batch->texture = texture;
+            batch->bounds = rect;
+            batch->first = i;
+            batch->last = i;
+            continue;
+        }
+
+        batch = &draw_list.batches[found];
+        SDL_UnionRect(&batch->bounds, &rect, &batch->bounds);
+        draw_list.cmds[batch->last].next = i;
+        batch->last = i;
+    }
+    return batch_count;
+}
+
+static void tex_module_destroy(tex_module_t* tex)
+{
+    // views do not own the texture
+    if (tex->owner)
+        SDL_DestroyTexture(tex->texture);
+    free(tex);
+    return;
+}
+
+// 1 when a recorded draw reads texture
+static int draw_list_uses(SDL_Texture* texture)
+{
+    for (int i = 0; i < draw_list.count; i++) {
+        if (draw_list.cmds[i].tex && draw_list.cmds[i].tex->texture == texture)
+            return 1;
+    }
+    return 0;
+}
+
+static void draw_list_release_frees(void)
+{
+    for (int i = 0; i < draw_list.free_count; i++) {
+        tex_module_destroy(draw_list.frees[i]);
+    }
+    draw_list.free_count = 0;
+    return;
+}
+
+// draws for render are recorded, not made right away
+static inline int draw_list_records(SDL_Renderer* render)
+{
+    return draw_list.active && draw_list.render == render;
+}
+
+static void draw_list_submit(SDL_Renderer* render)
+{
+    int quad;
+    int first;
+    int batch_count;
+    draw_cmd_t* cmds;
+
+    cmds = draw_list.cmds;
+    if (!draw_list.count)
+        return;
+
+    qsort(cmds, draw_list.count, sizeof(draw_cmd_t), draw_cmd_compare);
+
+    if (draw_list_reserve_quads(draw_list.count)) {
+        // no memory for vertices, still draw everything in order
+        for (int i = 0; i < draw_list.count; i++) {
+            draw_cmd_now(render, &cmds[i]);
+        }
+        draw_list.count = 0;
+        draw_list_release_frees();
+        return;
+    }
+
+    batch_count = draw_list_group();
+    quad = 0;
+    for (int i = 0; i < batch_count; i++) {
+        // shapes go through the SDL draw calls one by one
+        if (!draw_list.batches[i].texture) {
+            for (int j = draw_list.batches[i].first; j >= 0; j = cmds[j].next) {
+                prim_now(render, cmds[j].prim, cmds[j].x, cmds[j].y, cmds[j].flip);
+            }
+            continue;
+        }
+
+        first = quad;
+        for (int j = draw_list.batches[i].first; j >= 0; j = cmds[j].next) {
+            draw_cmd_quad(&cmds[j], &draw_list.vertices[quad * 4]);
+            quad++;
+        }
+
+        SDL_RenderGeometry(render, draw_list.batches[i].texture, &draw_list.vertices[first * 4],
+            (quad - first) * 4, draw_list.indices, (quad - first) * 6);
+    }
+    draw_list.count = 0;
+    draw_list_release_frees();
+    return;
+}
+
+static uint32_t sdl_pixel_format(int format)
+{
+    switch (format) {
+    case TEX_FORMAT_ABGR8888:
+        return SDL_PIXELFORMAT_ABGR8888;
+    case TEX_FORMAT_ARGB4444:
+        return SDL_PIXELFORMAT_ARGB4444;
+    case TEX_FORMAT_ARGB1555:
+        return SDL_PIXELFORMAT_ARGB1555;
+    }
+    return SDL_PIXELFORMAT_ARGB8888;
+}
+
+// the formats the renderer keeps as they are, anything else SDL converts on upload
+static int sdl_module_formats(void* user_data)
+{
+    int res;
+    SDL_RendererInfo info;
+
+    if (SDL_GetRendererInfo((SDL_Renderer*)user_data, &info))
+        return TEX_FORMAT_ARGB8888;
+
+    res = 0;
+    for (Uint32 i = 0; i < info.num_texture_formats; i++) {
+        switch (info.texture_formats[i]) {
+        case SDL_PIXELFORMAT_ARGB8888:
+            res |= TEX_FORMAT_ARGB8888;
+            break;
+        case SDL_PIXELFORMAT_ABGR8888:
+            res |= TEX_FORMAT_ABGR8888;
+            break;
+        case SDL_PIXELFORMAT_ARGB4444:
+            res |= TEX_FORMAT_ARGB4444;
+            break;
+        case SDL_PIXELFORMAT_ARGB1555:
+            res |= TEX_FORMAT_ARGB1555;
+            break;
+        }
+    }
+    if (!(res & (TEX_FORMAT_ARGB8888 | TEX_FORMAT_ABGR8888)))
+        res |= TEX_FORMAT_ARGB8888;
+    return res;
+}
+
+static void* sdl_module_new(void* pixels, int w, int h, int format, void* user_data)
 {
     SDL_Renderer* render;
     SDL_Texture* texture;
+    tex_module_t* res;
 
     render = (SDL_Renderer*)user_data;
-    texture = SDL_CreateTexture(render, SDL_PIXELFORMAT_BGRA32, SDL_TEXTUREACCESS_STATIC, w, h);
-    if (!texture) return NULL;
+    res = (tex_module_t*)malloc(sizeof(tex_module_t));
+    if (!res) return NULL;
+
+    texture = SDL_CreateTexture(render, sdl_pixel_format(format), SDL_TEXTUREACCESS_STATIC, w, h);
+    if (!texture) {
+        free(res);
+        return NULL;
+    }
 
-    if (SDL_UpdateTexture(texture, NULL, pixels, w *  4)) {
+    if (SDL_UpdateTexture(texture, NULL, pixels, w * TEX_FORMAT_BYTES(format))) {
         SDL_DestroyTexture(texture);
+        free(res);
         return NULL;
     }
     SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
 
-    return (void*)texture;
+    res->texture = texture;
+    res->rect.x = 0;
+    res->rect.y = 0;
+    res->rect.w = w;
+    res->rect.h = h;
+    res->tex_w = w;
+    res->tex_h = h;
+    res->texel_size = TEX_FORMAT_BYTES(format);
+    res->owner = 1;
+    return (void*)res;
 }
 
-void module_free(void* module, void* user_data)
+// streaming texture locked for an atlas page, written once and unlocked again
+// by sdl_module_end. single modules stay static, on GL a streaming texture
+// keeps a CPU copy of its pixels for its whole life
+static void* sdl_module_begin(int w, int h, int format, void** pixels, int* pitch, void* user_data)
 {
+    SDL_Renderer* render;
     SDL_Texture* texture;
+    tex_module_t* res;
+
+    render = (SDL_Renderer*)user_data;
+    res = (tex_module_t*)malloc(sizeof(tex_module_t));
+    if (!res) return NULL;
 
-    texture = (SDL_Texture*)module;
-    if (texture)
+    texture = SDL_CreateTexture(render, sdl_pixel_format(format), SDL_TEXTUREACCESS_STREAMING, w, h);
+    if (!texture) {
+        free(res);
+        return NULL;
+    }
+
+    if (SDL_LockTexture(texture, NULL, pixels, pitch)) {
         SDL_DestroyTexture(texture);
+        free(res);
+        return NULL;
+    }
+
+    res->texture = texture;
+    res->rect.x = 0;
+    res->rect.y = 0;
+    res->rect.w = w;
+    res->rect.h = h;
+    res->tex_w = w;
+    res->tex_h = h;
+    res->texel_size = TEX_FORMAT_BYTES(format);
+    res->owner = 1;
+    return (void*)res;
+}
+
+static int sdl_module_end(void* module, void* user_data)
+{
+    tex_module_t* tex;
+
+    tex = (tex_module_t*)module;
+    if (!tex)
+        return -1;
+
+    SDL_UnlockTexture(tex->texture);
+    SDL_SetTextureBlendMode(tex->texture, SDL_BLENDMODE_BLEND);
+    return 0;
+}
+
+static void* sdl_module_sub(void* module, int x, int y, int w, int h, void* user_data)
+{
+    tex_module_t* parent;
+    tex_module_t* res;
+
+    parent = (tex_module_t*)module;
+    if (!parent || w <= 0 || h <= 0)
+        return NULL;
+    if (x < 0 || y < 0 || x + w > parent->rect.w || y + h > parent->rect.h)
+        return NULL;
+
+    res = (tex_module_t*)malloc(sizeof(tex_module_t));
+    if (!res) return NULL;
+
+    res->texture = parent->texture;
+    res->rect.x = parent->rect.x + x;
+    res->rect.y = parent->rect.y + y;
+    res->rect.w = w;
+    res->rect.h = h;
+    res->tex_w = parent->tex_w;
+    res->tex_h = parent->tex_h;
+    res->texel_size = parent->texel_size;
+    res->owner = 0;
+    return (void*)res;
+}
+
+static int sdl_module_update(void* module, void* pixels, void* user_data)
+{
+    tex_module_t* tex;
+
+    tex = (tex_module_t*)module;
+    if (!tex || !pixels)
+        return -1;
+
+    // draws recorded so far show the old pixels
+    if (draw_list.active && draw_list_uses(tex->texture))
+        draw_list_submit(draw_list.render);
+    return SDL_UpdateTexture(tex->texture, &tex->rect, pixels, tex->rect.w * tex->texel_size);
+}
+
+// views share the texture, and with it the blend mode of their neighbours
+static void sdl_module_alpha(void* module, int alpha, void* user_data)
+{
+    tex_module_t* tex;
+
+    tex = (tex_module_t*)module;
+    if (!tex || !tex->owner)
+        return;
+
+    SDL_SetTextureBlendMode(tex->texture, alpha == TEX_ALPHA_OPAQUE ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
     return;
 }
 
-void module_paint(void* module, int x, int y, int flip, void* user_data)
+static void sdl_module_free(void* module, void* user_data)
+{
+    int capacity;
+    tex_module_t* tex;
+    tex_module_t** frees;
+
+    tex = (tex_module_t*)module;
+    if (!tex)
+        return;
+
+    // a recorded draw may still read it, wait for the submit
+    if (draw_list.active && draw_list.count) {
+        if (draw_list.free_count == draw_list.free_capacity) {
+            capacity = draw_list.free_capacity ? draw_list.free_capacity * 2 : 64;
+            frees = (tex_module_t**)realloc(draw_list.frees, capacity * sizeof(tex_module_t*));
+            if (frees) {
+                draw_list.frees = frees;
+                draw_list.free_capacity = capacity;
+            }
+        }
+        if (draw_list.free_count < draw_list.free_capacity) {
+            draw_list.frees[draw_list.free_count++] = tex;
+            return;
+        }
+        // no room to wait, draw what is recorded first
+        if (draw_list.render)
+            draw_list_submit(draw_list.render);
+    }
+    tex_module_destroy(tex);
+    return;
+}
+
+// records the draw of tex or prim, or draws it right away outside a batch
+static void draw_list_push(SDL_Renderer* render, tex_module_t* tex, const tex_prim_t* prim, int x, int y, int flip)
+{
+    int capacity;
+    draw_cmd_t* cmds;
+    draw_cmd_t* cmd;
+    draw_batch_t* batches;
+    draw_cmd_t now;
+
+    now.tex = tex;
+    now.prim = prim;
+    now.x = x;
+    now.y = y;
+    now.flip = flip;
+    if (!draw_list_records(render)) {
+        draw_cmd_now(render, &now);
+        return;
+    }
+
+    if (draw_list.count == draw_list.capacity) {
+        capacity = draw_list.capacity ? draw_list.capacity * 2 : 256;
+        cmds = (draw_cmd_t*)realloc(draw_list.cmds, capacity * sizeof(draw_cmd_t));
+        if (cmds)
+            draw_list.cmds = cmds;
+        batches = (draw_batch_t*)realloc(draw_list.batches, capacity * sizeof(draw_batch_t));
+        if (batches)
+            draw_list.batches = batches;
+        if (!cmds || !batches) {
+            // keep what is recorded below this one
+            draw_list_submit(render);
+            draw_cmd_now(render, &now);
+            return;
+        }
+        draw_list.capacity = capacity;
+    }
+
+    cmd = &draw_list.cmds[draw_list.count];
+    cmd->tex = tex;
+    cmd->prim = prim;
+    cmd->x = x;
+    cmd->y = y;
+    cmd->flip = flip;
+    cmd->layer = draw_list.layer;
+    cmd->seq = draw_list.count++;
+    return;
+}
+
+static void sdl_module_paint(void* module, int x, int y, int flip, void* user_data)
 {
-    int w, h;
-    double rotate;
-    SDL_Rect real_rect;
-    SDL_Texture* texture;
     SDL_Renderer* render;
-    SDL_RendererFlip real_flip;
+    tex_module_t* tex;
 
     render = (SDL_Renderer*)user_data;
-    texture = (SDL_Texture*)module;
-    if (!texture || !render)
+    tex = (tex_module_t*)module;
+    if (!tex || !render)
         return;
 
-    if (SDL_QueryTexture(texture, NULL, NULL, &w, &h))
+    draw_list_push(render, tex, NULL, x, y, flip);
+    return;
+}
+
+static void sdl_prim_paint(const tex_prim_t* prim, int x, int y, int flip, void* user_data)
+{
+    SDL_Renderer* render;
+
+    render = (SDL_Renderer*)user_data;
+    if (!prim || !render)
         return;
 
-    rotate = 0;
-    real_flip = SDL_FLIP_NONE;
-    real_rect.x = x;
-    real_rect.y = y;
-    real_rect.w = w;
-    real_rect.h = h;
-    switch (flip & FLIP_XY) {
-    case FLIP_Y:
-        rotate = 180;
-    case FLIP_X:
-        real_flip = SDL_FLIP_HORIZONTAL;
-        break;
-    case FLIP_XY:
-        rotate = 180;
-        break;
-    }
+    draw_list_push(render, NULL, prim, x, y, flip);
+    return;
+}
+
+static void sdl_batch_end(void* user_data);
+
+// one list for every renderer, the batch of another one is drawn first
+static void sdl_batch_begin(void* user_data)
+{
+    if (draw_list.active && draw_list.render != (SDL_Renderer*)user_data)
+        sdl_batch_end(draw_list.render);
+    draw_list.active = 1;
+    draw_list.render = (SDL_Renderer*)user_data;
+    draw_list.layer = 0;
+    draw_list.count = 0;
+    return;
+}
+
+static void sdl_batch_layer(int layer, void* user_data)
+{
+    if (draw_list_records((SDL_Renderer*)user_data))
+        draw_list.layer = layer;
+    return;
+}
+
+static void sdl_batch_end(void* user_data)
+{
+    SDL_Renderer* render;
 
-    SDL_RenderCopyEx(render, texture, NULL, &real_rect, rotate, NULL, real_flip);
+    render = (SDL_Renderer*)user_data;
+    if (!draw_list_records(render))
+        return;
+
+    if (render)
+        draw_list_submit(render);
+    draw_list.active = 0;
+    draw_list.count = 0;
+    draw_list_release_frees();
     return;
 }
+
+static int sdl_batch_active(void* user_data)
+{
+    return draw_list_records((SDL_Renderer*)user_data);
+}
+
+static void sdl_batch_release(void* user_data)
+{
+    sdl_batch_end(draw_list.render);
+    free(draw_list.cmds);
+    free(draw_list.batches);
+    free(draw_list.vertices);
+    free(draw_list.indices);
+    free(draw_list.frees);
+    memset(&draw_list, 0, sizeof(draw_list));
+    return;
+}
+
+// private variables
+const static tex_op_t sdl_op = {
+    sdl_module_formats,
+    sdl_module_new,
+    sdl_module_begin,
+    sdl_module_end,
+    sdl_module_sub,
+    sdl_module_update,
+    sdl_module_alpha,
+    sdl_module_free,
+    sdl_module_paint,
+    sdl_prim_paint,
+    sdl_batch_begin,
+    sdl_batch_layer,
+    sdl_batch_end,
+    sdl_batch_release,
+    sdl_batch_active
+};
+
+static const tex_op_t* global_op = &sdl_op;
+
+// public functions
+const tex_op_t* tex_get_sdl_op()
+{
+    return &sdl_op;
+}
+
+int tex_set_global_op(const tex_op_t* op)
+{
+    if (!op)
+        return -1;
+
+    global_op = op;
+    return 0;
+}
+
+const tex_op_t* tex_get_global_op()
+{
+    return global_op;
+}
+
+int module_formats(void* user_data)
+{
+    if (!global_op->module_formats)
+        return TEX_FORMAT_ARGB8888;
+
+    return global_op->module_formats(user_data);
+}
+
+void* module_new(void* pixels, int w, int h, int format, void* user_data)
+{
+    return global_op->module_new(pixels, w, h, format, user_data);
+}
+
+void* module_begin(int w, int h, int format, void** pixels, int* pitch, void* user_data)
+{
+    if (!global_op->module_begin)
+        return NULL;
+
+    return global_op->module_begin(w, h, format, pixels, pitch, user_data);
+}
+
+int module_end(void* module, void* user_data)
+{
+    if (!global_op->module_end)
+        return -1;
+
+    return global_op->module_end(module, user_data);
+}
+
+void* module_sub(void* module, int x, int y, int w, int h, void* user_data)
+{
+    return global_op->module_sub(module, x, y, w, h, user_data);
+}
+
+int module_update(void* module, void* pixels, void* user_data)
+{
+    return global_op->module_update(module, pixels, user_data);
+}
+
+void module_alpha(void* module, int alpha, void* user_data)
+{
+    if (!global_op->module_alpha)
+        return;
+
+    global_op->module_alpha(module, alpha, user_data);
+    return;
+}
+
+void module_free(void* module, void* user_data)
+{
+    global_op->module_free(module, user_data);
+    return;
+}
+
+void module_paint(void* module, int x, int y, int flip, void* user_data)
+{
+    global_op->module_paint(module, x, y, flip, user_data);
+    return;
+}
+
+void module_prim_paint(const tex_prim_t* prim, int x, int y, int flip, void* user_data)
+{
+    if (!global_op->prim_paint)
+        return;
+
+    global_op->prim_paint(prim, x, y, flip, user_data);
+    return;
+}
+
+void module_batch_begin(void* user_data)
+{
+    global_op->batch_begin(user_data);
+    return;
+}
+
+void module_batch_layer(int layer, void* user_data)
+{
+    global_op->batch_layer(layer, user_data);
+    return;
+}
+
+void module_batch_end(void* user_data)
+{
+    global_op->batch_end(user_data);
+    return;
+}
+
+void module_batch_release(void* user_data)
+{
+    global_op->batch_release(user_data);
+    return;
+}
+
+int module_batch_active(void* user_data)
+{
+    if (!global_op->batch_active)
+        return 0;
+
+    return global_op->batch_active(user_data);
+}
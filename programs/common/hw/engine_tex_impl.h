@@ -25,14 +25,125 @@
 #ifndef _ENGINE_TEX_IMPL_H_
 #define _ENGINE_TEX_IMPL_H_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// defines
+
+// texel layouts of module pixels, one bit each so a backend can list several.
+// values are native endian words, 16-bit formats take 2 bytes per texel
+#define TEX_FORMAT_ARGB8888 (0x1) // 0xAARRGGBB, what palettes decode to
+#define TEX_FORMAT_ABGR8888 (0x2) // 0xAABBGGRR
+#define TEX_FORMAT_ARGB4444 (0x4)
+#define TEX_FORMAT_ARGB1555 (0x8)
+
+#define TEX_FORMAT_BYTES(f) (((f) & (TEX_FORMAT_ARGB4444 | TEX_FORMAT_ARGB1555)) ? 2 : 4)
+
+// what the alpha of a module's pixels holds, known once they are decoded
+#define TEX_ALPHA_UNKNOWN   (0)
+#define TEX_ALPHA_EMPTY     (1) // nothing visible, no module gets made
+#define TEX_ALPHA_OPAQUE    (2) // every pixel 255, drawable without blending
+#define TEX_ALPHA_KEYED     (3) // every pixel 0 or 255
+#define TEX_ALPHA_BLEND     (4)
+
+// shapes prim_paint draws without a texture
+#define TEX_PRIM_RECT           (1) // 1 pixel outline inside the box
+#define TEX_PRIM_FILL_RECT      (2)
+#define TEX_PRIM_ARC            (3)
+#define TEX_PRIM_FILL_ARC       (4)
+#define TEX_PRIM_TRIANGLE       (5)
+#define TEX_PRIM_FILL_TRIANGLE  (6)
+
+// structs
+
+// a shape in a w * h box. arcs are the part of the ellipse filling the box
+// from start degrees on for arc degrees, counter clockwise from 3 o'clock.
+// triangles join the centers of the pixels (x[i], y[i]) of the box
+typedef struct tex_prim_s
+{
+    int type;       // TEX_PRIM_*, other values draw nothing
+    uint32_t color; // ARGB, straight alpha like module pixels
+    int w, h;
+    int start, arc; // arcs only
+    int x[3], y[3]; // triangles only
+} tex_prim_t;
+
+// a render backend, user_data of every call is what the sprite was loaded with:
+// an SDL_Renderer* for SDL, a soft_target_t* for soft, anything for null
+typedef struct tex_op_s
+{
+    // optional, TEX_FORMAT_* bits the backend takes without converting.
+    // NULL means TEX_FORMAT_ARGB8888 only
+    int   (*module_formats)(void *user_data);
+    // pixels are w * h texels of format, one of the bits module_formats lists
+    void* (*module_new)(void *pixels, int w, int h, int format, void *user_data);
+    // optional, a w * h module whose pixels the caller writes in place: *pixels
+    // gets rows pitch bytes apart, valid until module_end and never read back.
+    // module_end returns 0 once the module is usable, else the caller frees it.
+    // atlas pages use it, single modules always go through module_new
+    void* (*module_begin)(int w, int h, int format, void **pixels, int *pitch, void *user_data);
+    int   (*module_end)(void *module, void *user_data);
+    // view on a w * h region of module at (x, y), freeing it leaves module alive
+    void* (*module_sub)(void *module, int x, int y, int w, int h, void *user_data);
+    // pixels are in the format the module was made with
+    int   (*module_update)(void *module, void *pixels, void *user_data);
+    // optional, TEX_ALPHA_* of the pixels just put in module. a backend may
+    // draw TEX_ALPHA_OPAQUE ones without blending
+    void  (*module_alpha)(void *module, int alpha, void *user_data);
+    void  (*module_free)(void *module, void *user_data);
+    void  (*module_paint)(void *module, int x, int y, int flip, void *user_data);
+    // optional, draws prim with its box at (x, y), flip mirrors it inside the
+    // box like module pixels. NULL leaves prims undrawn
+    void  (*prim_paint)(const tex_prim_t *prim, int x, int y, int flip, void *user_data);
+
+    // between begin and end module_paint and prim_paint only record, end
+    // submits the list by layer then call order. prims must stay alive until
+    // end. module_free of a recorded module waits for the submit, and
+    // module_update submits what was recorded before it. a batch records
+    // for the user_data it began with only, others still draw right away,
+    // and beginning one for another user_data submits the one before
+    void  (*batch_begin)(void *user_data);
+    void  (*batch_layer)(int layer, void *user_data);
+    void  (*batch_end)(void *user_data);
+    void  (*batch_release)(void *user_data);
+    // optional, 1 between batch_begin and batch_end of this user_data
+    int   (*batch_active)(void *user_data);
+} tex_op_t;
+
 // public functions
-void* module_new(void *pixels, int w, int h, void *user_data);
+const tex_op_t* tex_get_sdl_op();
+const tex_op_t* tex_get_soft_op();
+// creates and paints nothing, for timing the sprite side alone
+const tex_op_t* tex_get_null_op();
+
+int             tex_set_global_op(const tex_op_t *op);
+const tex_op_t* tex_get_global_op();
+
+// through the global op
+int   module_formats(void *user_data);
+void* module_new(void *pixels, int w, int h, int format, void *user_data);
+void* module_begin(int w, int h, int format, void **pixels, int *pitch, void *user_data);
+int   module_end(void *module, void *user_data);
+void* module_sub(void *module, int x, int y, int w, int h, void *user_data);
+int   module_update(void *module, void *pixels, void *user_data);
+void  module_alpha(void *module, int alpha, void *user_data);
 void  module_free(void *module, void *user_data);
 void  module_paint(void *module, int x, int y, int flip, void *user_data);
+void  module_prim_paint(const tex_prim_t *prim, int x, int y, int flip, void *user_data);
+
+void  module_batch_begin(void *user_data);
+void  module_batch_layer(int layer, void *user_data);
+void  module_batch_end(void *user_data);
+void  module_batch_release(void *user_data);
+int   module_batch_active(void *user_data);
+
+// count pixels of a row of prim from column first on, as drawn without flip:
+// its color where it covers them, 0 elsewhere. what backends without shape
+// calls and the CPU side of the sprites rasterize prims with
+void  tex_prim_row(const tex_prim_t *prim, int row, int first, int count, uint32_t *out);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,129 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "engine_tex_impl.h"
+
+#include <stdlib.h> /* malloc, free */
+
+// private struct
+typedef struct null_module_s {
+    int w;
+    int h;
+} null_module_t;
+
+// private functions
+static void* null_module_new(void* pixels, int w, int h, int format, void* user_data)
+{
+    null_module_t* res;
+
+    // callers treat NULL as failure, so hand out a real handle
+    res = (null_module_t*)malloc(sizeof(null_module_t));
+    if (!res) return NULL;
+
+    res->w = w;
+    res->h = h;
+    return (void*)res;
+}
+
+static void* null_module_sub(void* module, int x, int y, int w, int h, void* user_data)
+{
+    null_module_t* parent;
+
+    parent = (null_module_t*)module;
+    if (!parent || w <= 0 || h <= 0)
+        return NULL;
+    if (x < 0 || y < 0 || x + w > parent->w || y + h > parent->h)
+        return NULL;
+
+    return null_module_new(NULL, w, h, TEX_FORMAT_ARGB8888, user_data);
+}
+
+static int null_module_update(void* module, void* pixels, void* user_data)
+{
+    if (!module || !pixels)
+        return -1;
+
+    return 0;
+}
+
+static void null_module_free(void* module, void* user_data)
+{
+    free(module);
+    return;
+}
+
+static void null_module_paint(void* module, int x, int y, int flip, void* user_data)
+{
+    return;
+}
+
+static void null_prim_paint(const tex_prim_t* prim, int x, int y, int flip, void* user_data)
+{
+    return;
+}
+
+static void null_batch_begin(void* user_data)
+{
+    return;
+}
+
+static void null_batch_layer(int layer, void* user_data)
+{
+    return;
+}
+
+static void null_batch_end(void* user_data)
+{
+    return;
+}
+
+static void null_batch_release(void* user_data)
+{
+    return;
+}
+
+// private variables
+const static tex_op_t null_op = {
+    NULL,
+    null_module_new,
+    NULL, // nothing to write into, atlas pages go through module_new
+    NULL,
+    null_module_sub,
+    null_module_update,
+    NULL,
+    null_module_free,
+    null_module_paint,
+    null_prim_paint,
+    null_batch_begin,
+    null_batch_layer,
+    null_batch_end,
+    null_batch_release,
+    NULL  // draws nothing, so it never records
+};
+
+// public functions
+const tex_op_t* tex_get_null_op()
+{
+    return &null_op;
+}
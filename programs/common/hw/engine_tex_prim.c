@@ -0,0 +1,251 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "engine_tex_impl.h"
+
+#include <string.h> /* memset */
+
+// fixed point of the sine table, 1.0
+#define PRIM_ONE 16384
+
+// private data
+
+// sin of 0 to 90 degrees in PRIM_ONE units, arcs take whole degrees
+static const int prim_sin_table[91] = {
+    0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+    2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+    5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+    8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+    10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+    12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+    14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+    15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+    16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+    16384
+};
+
+// private functions
+static int prim_sin(int deg)
+{
+    deg %= 360;
+    if (deg < 0)
+        deg += 360;
+
+    if (deg <= 90)
+        return prim_sin_table[deg];
+    if (deg <= 180)
+        return prim_sin_table[180 - deg];
+    if (deg <= 270)
+        return -prim_sin_table[deg - 180];
+    return -prim_sin_table[360 - deg];
+}
+
+// d > 0
+static inline int64_t floor_div(int64_t n, int64_t d)
+{
+    return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
+
+static inline int64_t round_div(int64_t n, int64_t d)
+{
+    if (d < 0) {
+        n = -n;
+        d = -d;
+    }
+    return floor_div(2 * n + d, 2 * d);
+}
+
+// columns [x0, x1) of the row, out starts at column first
+static void prim_span(uint32_t* out, int first, int count, int x0, int x1, uint32_t color)
+{
+    if (x0 < first)
+        x0 = first;
+    if (x1 > first + count)
+        x1 = first + count;
+    for (int x = x0; x < x1; x++) {
+        out[x - first] = color;
+    }
+    return;
+}
+
+// pixel centers on or between the edges, the row crosses a triangle once
+static void prim_fill_triangle(const tex_prim_t* prim, int row, int first, int count, uint32_t* out)
+{
+    int64_t x0, x1;
+
+    x0 = INT64_MAX;
+    x1 = INT64_MIN;
+    for (int i = 0; i < 3; i++) {
+        int xa = prim->x[i], ya = prim->y[i];
+        int xb = prim->x[(i + 1) % 3], yb = prim->y[(i + 1) % 3];
+        int64_t n, d, lo, hi;
+
+        if ((row < ya && row < yb) || (row > ya && row > yb))
+            continue;
+        if (ya == yb) {
+            lo = xa < xb ? xa : xb;
+            hi = xa < xb ? xb : xa;
+        } else {
+            // xa + n / d where the edge meets the row
+            n = (int64_t)(row - ya) * (xb - xa);
+            d = yb - ya;
+            if (d < 0) {
+                n = -n;
+                d = -d;
+            }
+            lo = xa - floor_div(-n, d);
+            hi = xa + floor_div(n, d);
+        }
+        if (lo < x0) x0 = lo;
+        if (hi > x1) x1 = hi;
+    }
+    if (x0 <= x1)
+        prim_span(out, first, count, (int)x0, (int)x1 + 1, prim->color);
+    return;
+}
+
+// the pixels a line between the corners steps through, one per row or
+// one per column whichever it crosses more of
+static void prim_triangle(const tex_prim_t* prim, int row, int first, int count, uint32_t* out)
+{
+    for (int i = 0; i < 3; i++) {
+        int xa = prim->x[i], ya = prim->y[i];
+        int xb = prim->x[(i + 1) % 3], yb = prim->y[(i + 1) % 3];
+        int dx = xb - xa, dy = yb - ya;
+        int adx = dx < 0 ? -dx : dx, ady = dy < 0 ? -dy : dy;
+        int x0, x1;
+
+        if ((row < ya && row < yb) || (row > ya && row > yb))
+            continue;
+        if (ady >= adx) {
+            x0 = xa + (dy ? (int)round_div((int64_t)(row - ya) * dx, dy) : 0);
+            prim_span(out, first, count, x0, x0 + 1, prim->color);
+            continue;
+        }
+
+        x0 = xa < xb ? xa : xb;
+        x1 = xa < xb ? xb : xa;
+        if (x0 < first)
+            x0 = first;
+        if (x1 > first + count - 1)
+            x1 = first + count - 1;
+        for (int x = x0; x <= x1; x++) {
+            if (ya + round_div((int64_t)(x - xa) * dy, dx) == row)
+                out[x - first] = prim->color;
+        }
+    }
+    return;
+}
+
+// centers inside the ellipse, for outlines not inside the one a pixel in.
+// with x and y scaled by h and w the ellipse is a circle of radius w * h,
+// so the angle test compares directions with the sine table
+static void prim_arc(const tex_prim_t* prim, int row, int first, int count, uint32_t* out)
+{
+    int w, h;
+    int start, arc;
+    int64_t px, py;
+    int64_t sx, sy, ex, ey;
+    int64_t r, ri;
+    int inner;
+
+    w = prim->w;
+    h = prim->h;
+    start = prim->start;
+    arc = prim->arc;
+    if (arc < 0) {
+        start += arc;
+        arc = -arc;
+    }
+    if (!arc)
+        return;
+    sx = prim_sin(start + 90);
+    sy = prim_sin(start);
+    ex = prim_sin(start + arc + 90);
+    ey = prim_sin(start + arc);
+
+    r = (int64_t)w * h;
+    ri = (int64_t)(w - 2) * (h - 2);
+    inner = prim->type == TEX_PRIM_ARC && w > 2 && h > 2;
+    py = (int64_t)(h - 2 * row - 1);
+    for (int x = first; x < first + count; x++) {
+        int64_t ix, iy;
+        int64_t cs, ce;
+
+        px = (int64_t)(2 * x + 1 - w);
+        if (px * h * px * h + py * w * py * w > r * r)
+            continue;
+        if (inner) {
+            ix = px * (h - 2);
+            iy = py * (w - 2);
+            if (ix * ix + iy * iy < ri * ri)
+                continue;
+        }
+        if (arc < 360) {
+            // cross products of the direction with the start and end ones
+            cs = sx * (py * w) - sy * (px * h);
+            ce = (px * h) * ey - (py * w) * ex;
+            if (arc <= 180 ? (cs < 0 || ce < 0) : (cs < 0 && ce < 0))
+                continue;
+        }
+        out[x - first] = prim->color;
+    }
+    return;
+}
+
+// public functions
+void tex_prim_row(const tex_prim_t* prim, int row, int first, int count, uint32_t* out)
+{
+    if (count <= 0)
+        return;
+
+    memset(out, 0, count * sizeof(uint32_t));
+    if (!prim || row < 0 || row >= prim->h || first < 0 || first + count > prim->w)
+        return;
+
+    switch (prim->type) {
+    case TEX_PRIM_RECT:
+        if (row == 0 || row == prim->h - 1) {
+            prim_span(out, first, count, 0, prim->w, prim->color);
+            break;
+        }
+        prim_span(out, first, count, 0, 1, prim->color);
+        prim_span(out, first, count, prim->w - 1, prim->w, prim->color);
+        break;
+    case TEX_PRIM_FILL_RECT:
+        prim_span(out, first, count, 0, prim->w, prim->color);
+        break;
+    case TEX_PRIM_ARC:
+    case TEX_PRIM_FILL_ARC:
+        prim_arc(prim, row, first, count, out);
+        break;
+    case TEX_PRIM_TRIANGLE:
+        prim_triangle(prim, row, first, count, out);
+        break;
+    case TEX_PRIM_FILL_TRIANGLE:
+        prim_fill_triangle(prim, row, first, count, out);
+        break;
+    }
+    return;
+}
@@ -0,0 +1,930 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "engine_tex_soft.h"
+#include "thread_impl.h"
+
+#include <stdlib.h> /* malloc, free, qsort */
+#include <string.h> /* memcpy, memset */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFT_HAVE_SSE2
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SOFT_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#define FLIP_NONE 0
+#define FLIP_X 1
+#define FLIP_Y 2
+#define FLIP_XY (FLIP_X|FLIP_Y)
+
+#define SOFT_MAX_THREADS 16
+// below this many draws a batch is not worth splitting into bands
+#define SOFT_THREAD_MIN_DRAWS 64
+#define SOFT_FLIP_CHUNK 64
+
+// private struct
+typedef struct soft_module_s {
+    uint32_t* pixels;
+    int w;
+    int h;
+    int stride; // in pixels, views share the parent rows
+    int owner;  // 0 for views created by module_sub
+    int opaque; // TEX_ALPHA_OPAQUE, rows are copied instead of blended
+} soft_module_t;
+
+typedef struct soft_cmd_s {
+    soft_module_t* module;
+    const tex_prim_t* prim; // set instead of module for shapes
+    int x;
+    int y;
+    int flip;
+    int layer;
+    int seq; // record order, keeps the sort stable
+} soft_cmd_t;
+
+typedef struct soft_list_s {
+    int active;
+    soft_target_t* target; // the batch records for this one only
+    int layer;
+    int count;
+    int capacity;
+    soft_cmd_t* cmds;
+    // modules freed while recorded, freed for real once submitted
+    int free_count;
+    int free_capacity;
+    void** frees;
+} soft_list_t;
+
+typedef struct soft_band_s {
+    soft_target_t* target;
+    const soft_cmd_t* cmds;
+    int count;
+    int y0;
+    int y1;
+} soft_band_t;
+
+typedef struct soft_pool_s soft_pool_t;
+
+typedef struct soft_worker_s {
+    soft_pool_t* pool;
+    int index; // band it paints, band 0 is the caller's
+} soft_worker_t;
+
+// band threads of a target, they sleep on wake between batches
+struct soft_pool_s {
+    mutex_t* lock;
+    cond_t* wake;
+    cond_t* done;
+    int asked;        // bands it was made for
+    int thread_count; // counting the caller, fewer than asked when threads failed
+    int generation; // bumped for every batch handed out
+    int band_count; // bands of the current batch
+    int pending;    // worker bands not painted yet
+    int quit;
+    soft_band_t bands[SOFT_MAX_THREADS];
+    soft_worker_t workers[SOFT_MAX_THREADS];
+    thread_t* threads[SOFT_MAX_THREADS];
+};
+
+typedef void (*blend_row_t)(uint32_t* dst, const uint32_t* src, int count);
+
+// private data
+static soft_list_t draw_list = { 0 };
+static blend_row_t blend_row = NULL;
+
+// private functions
+
+// SDL_BLENDMODE_BLEND on straight alpha: c = (s * a + d * (255 - a)) / 255,
+// the source alpha channel counts as 255 so dst alpha becomes a + da * (1 - a)
+static inline uint32_t blend_pixel(uint32_t d, uint32_t s)
+{
+    uint32_t a;
+    uint32_t t;
+    uint32_t res;
+
+    a = s >> 24;
+    if (a == 0xFF)
+        return s;
+    if (!a)
+        return d;
+
+    s |= 0xFF000000;
+    res = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        t = ((s >> shift) & 0xFF) * a + ((d >> shift) & 0xFF) * (255 - a) + 128;
+        res |= ((t + (t >> 8)) >> 8) << shift;
+    }
+    return res;
+}
+
+// blend_pixel of an alpha 255 source is the source
+static void copy_row(uint32_t* dst, const uint32_t* src, int count)
+{
+    memcpy(dst, src, count * sizeof(uint32_t));
+    return;
+}
+
+static void blend_row_c(uint32_t* dst, const uint32_t* src, int count)
+{
+    for (int i = 0; i < count; i++) {
+        dst[i] = blend_pixel(dst[i], src[i]);
+    }
+    return;
+}
+
+#ifdef SOFT_HAVE_SSE2
+// same arithmetic as blend_pixel on 16 bit lanes
+static inline __m128i blend_half_sse2(__m128i s, __m128i d, __m128i a)
+{
+    __m128i t;
+
+    t = _mm_add_epi16(_mm_mullo_epi16(s, a),
+        _mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), a)));
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void blend_row_sse2(uint32_t* dst, const uint32_t* src, int count)
+{
+    int i;
+    int mask;
+    __m128i s, d, a;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i amask = _mm_set1_epi32((int)0xFF000000);
+
+    for (i = 0; i + 4 <= count; i += 4) {
+        s = _mm_loadu_si128((const __m128i*)(src + i));
+        a = _mm_and_si128(s, amask);
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi32(a, amask));
+        if (mask == 0xFFFF) {
+            _mm_storeu_si128((__m128i*)(dst + i), s);
+            continue;
+        }
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi32(a, zero));
+        if (mask == 0xFFFF)
+            continue;
+
+        d = _mm_loadu_si128((const __m128i*)(dst + i));
+        a = _mm_srli_epi32(s, 24);
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+        s = _mm_or_si128(s, amask);
+        s = _mm_packus_epi16(
+            blend_half_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(a, a)),
+            blend_half_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(a, a)));
+        _mm_storeu_si128((__m128i*)(dst + i), s);
+    }
+    blend_row_c(dst + i, src + i, count - i);
+    return;
+}
+#endif
+
+#ifdef SOFT_HAVE_AVX2
+__attribute__((target("avx2")))
+static inline __m256i blend_half_avx2(__m256i s, __m256i d, __m256i a)
+{
+    __m256i t;
+
+    t = _mm256_add_epi16(_mm256_mullo_epi16(s, a),
+        _mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(255), a)));
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+static void blend_row_avx2(uint32_t* dst, const uint32_t* src, int count)
+{
+    int i;
+    __m256i s, d, a;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i amask = _mm256_set1_epi32((int)0xFF000000);
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        s = _mm256_loadu_si256((const __m256i*)(src + i));
+        a = _mm256_and_si256(s, amask);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, amask)) == -1) {
+            _mm256_storeu_si256((__m256i*)(dst + i), s);
+            continue;
+        }
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, zero)) == -1)
+            continue;
+
+        // unpack works per 128 bit lane on s, d and a alike so pixels stay paired
+        d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        a = _mm256_srli_epi32(s, 24);
+        a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+        s = _mm256_or_si256(s, amask);
+        s = _mm256_packus_epi16(
+            blend_half_avx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi32(a, a)),
+            blend_half_avx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi32(a, a)));
+        _mm256_storeu_si256((__m256i*)(dst + i), s);
+    }
+    blend_row_sse2(dst + i, src + i, count - i);
+    return;
+}
+#endif
+
+static void soft_pick_kernel(void)
+{
+    if (blend_row)
+        return;
+
+#if defined(SOFT_HAVE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        blend_row = blend_row_avx2;
+        return;
+    }
+#endif
+#if defined(SOFT_HAVE_SSE2)
+    blend_row = blend_row_sse2;
+#else
+    blend_row = blend_row_c;
+#endif
+    return;
+}
+
+// part of the rows [*y0, *y1) of target a w * h box at (x, y) covers,
+// 0 when it is empty
+static int soft_clip(const soft_target_t* target, int x, int y, int w, int h,
+    int* x0, int* x1, int* y0, int* y1)
+{
+    *x0 = x > target->clip_x ? x : target->clip_x;
+    *x1 = x + w;
+    if (*x1 > target->clip_x + target->clip_w)
+        *x1 = target->clip_x + target->clip_w;
+    if (*y0 < target->clip_y)
+        *y0 = target->clip_y;
+    if (*y0 < y)
+        *y0 = y;
+    if (*y1 > target->clip_y + target->clip_h)
+        *y1 = target->clip_y + target->clip_h;
+    if (*y1 > y + h)
+        *y1 = y + h;
+    return *x0 < *x1 && *y0 < *y1;
+}
+
+// draws the rows [y0, y1) of target that module covers at (x, y)
+static void soft_paint(soft_target_t* target, const soft_module_t* module,
+    int x, int y, int flip, int y0, int y1)
+{
+    int sx;
+    int sy;
+    int run;
+    int col;
+    int count;
+    int x0, x1;
+    uint32_t* dst;
+    const uint32_t* src;
+    blend_row_t row;
+    uint32_t tmp[SOFT_FLIP_CHUNK];
+
+    if (!soft_clip(target, x, y, module->w, module->h, &x0, &x1, &y0, &y1))
+        return;
+
+    count = x1 - x0;
+    col = x0 - x;
+    row = module->opaque ? copy_row : blend_row;
+    for (int dy = y0; dy < y1; dy++) {
+        sy = dy - y;
+        if (flip & FLIP_Y)
+            sy = module->h - 1 - sy;
+        src = module->pixels + sy * module->stride;
+        dst = target->pixels + dy * target->pitch + x0;
+
+        if (!(flip & FLIP_X)) {
+            row(dst, src + col, count);
+            continue;
+        }
+
+        // mirror into a small buffer so the kernels only see forward rows
+        sx = module->w - 1 - col;
+        for (int i = 0; i < count; i += run) {
+            run = count - i < SOFT_FLIP_CHUNK ? count - i : SOFT_FLIP_CHUNK;
+            for (int j = 0; j < run; j++) {
+                tmp[j] = src[sx - i - j];
+            }
+            row(dst + i, tmp, run);
+        }
+    }
+    return;
+}
+
+// same for prim, rasterized a chunk of a row at a time
+static void soft_paint_prim(soft_target_t* target, const tex_prim_t* prim,
+    int x, int y, int flip, int y0, int y1)
+{
+    int sy;
+    int run;
+    int col;
+    int count;
+    int x0, x1;
+    uint32_t t;
+    uint32_t* dst;
+    uint32_t tmp[SOFT_FLIP_CHUNK];
+
+    if (!soft_clip(target, x, y, prim->w, prim->h, &x0, &x1, &y0, &y1))
+        return;
+
+    count = x1 - x0;
+    col = x0 - x;
+    for (int dy = y0; dy < y1; dy++) {
+        sy = dy - y;
+        if (flip & FLIP_Y)
+            sy = prim->h - 1 - sy;
+        dst = target->pixels + dy * target->pitch + x0;
+
+        for (int i = 0; i < count; i += run) {
+            run = count - i < SOFT_FLIP_CHUNK ? count - i : SOFT_FLIP_CHUNK;
+            if (!(flip & FLIP_X)) {
+                tex_prim_row(prim, sy, col + i, run, tmp);
+            } else {
+                tex_prim_row(prim, sy, prim->w - col - i - run, run, tmp);
+                for (int j = 0; j < run / 2; j++) {
+                    t = tmp[j];
+                    tmp[j] = tmp[run - 1 - j];
+                    tmp[run - 1 - j] = t;
+                }
+            }
+            blend_row(dst + i, tmp, run);
+        }
+    }
+    return;
+}
+
+static void soft_cmd_paint(soft_target_t* target, const soft_cmd_t* cmd, int y0, int y1)
+{
+    if (cmd->module)
+        soft_paint(target, cmd->module, cmd->x, cmd->y, cmd->flip, y0, y1);
+    else
+        soft_paint_prim(target, cmd->prim, cmd->x, cmd->y, cmd->flip, y0, y1);
+    return;
+}
+
+static int soft_cmd_compare(const void* a, const void* b)
+{
+    const soft_cmd_t* ca;
+    const soft_cmd_t* cb;
+
+    ca = (const soft_cmd_t*)a;
+    cb = (const soft_cmd_t*)b;
+    if (ca->layer != cb->layer)
+        return ca->layer < cb->layer ? -1 : 1;
+
+    return ca->seq - cb->seq;
+}
+
+static void soft_band_paint(const soft_band_t* band)
+{
+    for (int i = 0; i < band->count; i++) {
+        soft_cmd_paint(band->target, &band->cmds[i], band->y0, band->y1);
+    }
+    return;
+}
+
+static int soft_pool_worker(void* arg)
+{
+    int seen;
+    soft_pool_t* pool;
+    soft_worker_t* worker;
+
+    worker = (soft_worker_t*)arg;
+    pool = worker->pool;
+    seen = 0;
+    mutex_lock(pool->lock);
+    while (1) {
+        while (!pool->quit && seen == pool->generation) {
+            cond_wait(pool->wake, pool->lock);
+        }
+        if (pool->quit)
+            break;
+        seen = pool->generation;
+        if (worker->index >= pool->band_count)
+            continue;
+
+        mutex_unlock(pool->lock);
+        soft_band_paint(&pool->bands[worker->index]);
+        mutex_lock(pool->lock);
+        if (!--pool->pending)
+            cond_signal(pool->done);
+    }
+    mutex_unlock(pool->lock);
+    return 0;
+}
+
+static void soft_pool_free(soft_pool_t* pool)
+{
+    if (!pool)
+        return;
+
+    mutex_lock(pool->lock);
+    pool->quit = 1;
+    cond_broadcast(pool->wake);
+    mutex_unlock(pool->lock);
+    for (int i = 1; i < pool->thread_count; i++) {
+        thread_join(pool->threads[i]);
+    }
+    cond_free(pool->done);
+    cond_free(pool->wake);
+    mutex_free(pool->lock);
+    free(pool);
+    return;
+}
+
+// workers for bands 1 .. thread_count - 1. the pool may end up with fewer
+// when threads fail to start, NULL when none did
+static soft_pool_t* soft_pool_new(int thread_count)
+{
+    soft_pool_t* pool;
+
+    pool = (soft_pool_t*)calloc(1, sizeof(soft_pool_t));
+    if (!pool)
+        return NULL;
+
+    pool->lock = mutex_create();
+    pool->wake = cond_create();
+    pool->done = cond_create();
+    if (!pool->lock || !pool->wake || !pool->done) {
+        soft_pool_free(pool);
+        return NULL;
+    }
+
+    pool->asked = thread_count;
+    pool->thread_count = 1;
+    for (int i = 1; i < thread_count; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pool->threads[i] = thread_create(soft_pool_worker, "soft_band", &pool->workers[i]);
+        if (!pool->threads[i])
+            break;
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 1) {
+        soft_pool_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// 1 when a recorded draw reads rows of module, views share their parent rows
+static int soft_list_uses(const soft_module_t* module)
+{
+    const uint32_t* begin;
+    const uint32_t* end;
+    const soft_module_t* other;
+
+    begin = module->pixels;
+    end = module->pixels + (module->h - 1) * module->stride + module->w;
+    for (int i = 0; i < draw_list.count; i++) {
+        other = draw_list.cmds[i].module;
+        if (!other)
+            continue;
+        if (other->pixels < end && begin < other->pixels + (other->h - 1) * other->stride + other->w)
+            return 1;
+    }
+    return 0;
+}
+
+static void soft_list_release_frees(void)
+{
+    for (int i = 0; i < draw_list.free_count; i++) {
+        free(draw_list.frees[i]);
+    }
+    draw_list.free_count = 0;
+    return;
+}
+
+// every band walks the whole list in order, so draw order holds without locks
+static void soft_list_submit(soft_target_t* target)
+{
+    int band_h;
+    int band_count;
+    soft_pool_t* pool;
+    soft_band_t* bands;
+    soft_band_t band;
+
+    if (!draw_list.count)
+        return;
+
+    qsort(draw_list.cmds, draw_list.count, sizeof(soft_cmd_t), soft_cmd_compare);
+
+    band_count = 1;
+    if (draw_list.count >= SOFT_THREAD_MIN_DRAWS)
+        band_count = target->thread_count;
+    if (band_count > SOFT_MAX_THREADS)
+        band_count = SOFT_MAX_THREADS;
+    if (band_count > target->clip_h)
+        band_count = target->clip_h;
+
+    // the workers stay with the target, made again when thread_count grows
+    pool = (soft_pool_t*)target->pool;
+    if (band_count > 1 && (!pool || pool->asked < band_count)) {
+        soft_pool_free(pool);
+        pool = soft_pool_new(band_count);
+        target->pool = pool;
+    }
+    if (!pool || band_count < 1)
+        band_count = 1;
+    if (pool && band_count > pool->thread_count)
+        band_count = pool->thread_count;
+
+    band_h = (target->clip_h + band_count - 1) / band_count;
+    bands = pool ? pool->bands : &band;
+    for (int i = 0; i < band_count; i++) {
+        bands[i].target = target;
+        bands[i].cmds = draw_list.cmds;
+        bands[i].count = draw_list.count;
+        bands[i].y0 = target->clip_y + i * band_h;
+        bands[i].y1 = bands[i].y0 + band_h;
+    }
+
+    if (band_count > 1) {
+        mutex_lock(pool->lock);
+        pool->band_count = band_count;
+        pool->pending = band_count - 1;
+        pool->generation++;
+        cond_broadcast(pool->wake);
+        mutex_unlock(pool->lock);
+    }
+    soft_band_paint(&bands[0]);
+    if (band_count > 1) {
+        mutex_lock(pool->lock);
+        while (pool->pending) {
+            cond_wait(pool->done, pool->lock);
+        }
+        mutex_unlock(pool->lock);
+    }
+    draw_list.count = 0;
+    soft_list_release_frees();
+    return;
+}
+
+// module_formats is NULL, the blender only reads ARGB8888
+static void* soft_module_new(void* pixels, int w, int h, int format, void* user_data)
+{
+    soft_module_t* res;
+
+    if (!pixels || w <= 0 || h <= 0 || format != TEX_FORMAT_ARGB8888)
+        return NULL;
+
+    // one block, rows follow the header
+    res = (soft_module_t*)malloc(sizeof(soft_module_t) + (size_t)w * h * 4);
+    if (!res) return NULL;
+
+    res->pixels = (uint32_t*)(res + 1);
+    res->w = w;
+    res->h = h;
+    res->stride = w;
+    res->owner = 1;
+    res->opaque = 0;
+    memcpy(res->pixels, pixels, (size_t)w * h * 4);
+    return (void*)res;
+}
+
+// same block as soft_module_new, the decoder fills the rows itself
+static void* soft_module_begin(int w, int h, int format, void** pixels, int* pitch, void* user_data)
+{
+    soft_module_t* res;
+
+    if (w <= 0 || h <= 0 || format != TEX_FORMAT_ARGB8888)
+        return NULL;
+
+    res = (soft_module_t*)malloc(sizeof(soft_module_t) + (size_t)w * h * 4);
+    if (!res) return NULL;
+
+    res->pixels = (uint32_t*)(res + 1);
+    res->w = w;
+    res->h = h;
+    res->stride = w;
+    res->owner = 1;
+    res->opaque = 0;
+    *pixels = res->pixels;
+    *pitch = w * 4;
+    return (void*)res;
+}
+
+static int soft_module_end(void* module, void* user_data)
+{
+    return module ? 0 : -1;
+}
+
+static void* soft_module_sub(void* module, int x, int y, int w, int h, void* user_data)
+{
+    soft_module_t* parent;
+    soft_module_t* res;
+
+    parent = (soft_module_t*)module;
+    if (!parent || w <= 0 || h <= 0)
+        return NULL;
+    if (x < 0 || y < 0 || x + w > parent->w || y + h > parent->h)
+        return NULL;
+
+    res = (soft_module_t*)malloc(sizeof(soft_module_t));
+    if (!res) return NULL;
+
+    res->pixels = parent->pixels + y * parent->stride + x;
+    res->w = w;
+    res->h = h;
+    res->stride = parent->stride;
+    res->owner = 0;
+    res->opaque = parent->opaque;
+    return (void*)res;
+}
+
+static int soft_module_update(void* module, void* pixels, void* user_data)
+{
+    soft_module_t* soft;
+
+    soft = (soft_module_t*)module;
+    if (!soft || !pixels)
+        return -1;
+
+    // draws recorded so far show the old pixels
+    if (draw_list.active && soft_list_uses(soft))
+        soft_list_submit(draw_list.target);
+    for (int y = 0; y < soft->h; y++) {
+        memcpy(soft->pixels + y * soft->stride, (uint32_t*)pixels + y * soft->w, soft->w * 4);
+    }
+    // blended until told otherwise
+    soft->opaque = 0;
+    return 0;
+}
+
+static void soft_module_alpha(void* module, int alpha, void* user_data)
+{
+    soft_module_t* soft;
+
+    soft = (soft_module_t*)module;
+    if (!soft)
+        return;
+
+    soft->opaque = alpha == TEX_ALPHA_OPAQUE;
+    return;
+}
+
+static void soft_module_free(void* module, void* user_data)
+{
+    int capacity;
+    void** frees;
+    soft_target_t* target;
+
+    // a recorded draw may still read it, wait for the submit
+    if (module && draw_list.active && draw_list.count) {
+        if (draw_list.free_count == draw_list.free_capacity) {
+            capacity = draw_list.free_capacity ? draw_list.free_capacity * 2 : 64;
+            frees = (void**)realloc(draw_list.frees, capacity * sizeof(void*));
+            if (frees) {
+                draw_list.frees = frees;
+                draw_list.free_capacity = capacity;
+            }
+        }
+        if (draw_list.free_count < draw_list.free_capacity) {
+            draw_list.frees[draw_list.free_count++] = module;
+            return;
+        }
+        // no room to wait, draw what is recorded first
+        target = draw_list.target;
+        if (target && target->pixels)
+            soft_list_submit(target);
+    }
+    // views and owners are a single allocation each
+    free(module);
+    return;
+}
+
+// draws for target are recorded, not made right away
+static inline int soft_list_records(soft_target_t* target)
+{
+    return draw_list.active && draw_list.target == target;
+}
+
+// records the draw of module or prim, or draws it right away outside a batch
+static void soft_list_push(soft_target_t* target, soft_module_t* module, const tex_prim_t* prim,
+    int x, int y, int flip)
+{
+    int capacity;
+    soft_cmd_t* cmds;
+    soft_cmd_t* cmd;
+    soft_cmd_t now;
+
+    now.module = module;
+    now.prim = prim;
+    now.x = x;
+    now.y = y;
+    now.flip = flip;
+    if (!soft_list_records(target)) {
+        soft_pick_kernel();
+        soft_cmd_paint(target, &now, target->clip_y, target->clip_y + target->clip_h);
+        return;
+    }
+
+    if (draw_list.count == draw_list.capacity) {
+        capacity = draw_list.capacity ? draw_list.capacity * 2 : 256;
+        cmds = (soft_cmd_t*)realloc(draw_list.cmds, capacity * sizeof(soft_cmd_t));
+        if (!cmds) {
+            // keep what is recorded below this one
+            soft_list_submit(target);
+            soft_cmd_paint(target, &now, target->clip_y, target->clip_y + target->clip_h);
+            return;
+        }
+        draw_list.cmds = cmds;
+        draw_list.capacity = capacity;
+    }
+
+    cmd = &draw_list.cmds[draw_list.count];
+    cmd->module = module;
+    cmd->prim = prim;
+    cmd->x = x;
+    cmd->y = y;
+    cmd->flip = flip;
+    cmd->layer = draw_list.layer;
+    cmd->seq = draw_list.count++;
+    return;
+}
+
+static void soft_module_paint(void* module, int x, int y, int flip, void* user_data)
+{
+    soft_target_t* target;
+    soft_module_t* soft;
+
+    target = (soft_target_t*)user_data;
+    soft = (soft_module_t*)module;
+    if (!soft || !target || !target->pixels)
+        return;
+
+    soft_list_push(target, soft, NULL, x, y, flip);
+    return;
+}
+
+static void soft_prim_paint(const tex_prim_t* prim, int x, int y, int flip, void* user_data)
+{
+    soft_target_t* target;
+
+    target = (soft_target_t*)user_data;
+    if (!prim || !target || !target->pixels)
+        return;
+
+    soft_list_push(target, NULL, prim, x, y, flip);
+    return;
+}
+
+static void soft_batch_end(void* user_data);
+
+// one list for every target, the batch of another one is drawn first
+static void soft_batch_begin(void* user_data)
+{
+    soft_pick_kernel();
+    if (draw_list.active && draw_list.target != (soft_target_t*)user_data)
+        soft_batch_end(draw_list.target);
+    draw_list.active = 1;
+    draw_list.target = (soft_target_t*)user_data;
+    draw_list.layer = 0;
+    draw_list.count = 0;
+    return;
+}
+
+static void soft_batch_layer(int layer, void* user_data)
+{
+    if (soft_list_records((soft_target_t*)user_data))
+        draw_list.layer = layer;
+    return;
+}
+
+static void soft_batch_end(void* user_data)
+{
+    soft_target_t* target;
+
+    target = (soft_target_t*)user_data;
+    if (!soft_list_records(target))
+        return;
+
+    if (target && target->pixels)
+        soft_list_submit(target);
+    draw_list.active = 0;
+    draw_list.count = 0;
+    soft_list_release_frees();
+    return;
+}
+
+static int soft_batch_active(void* user_data)
+{
+    return soft_list_records((soft_target_t*)user_data);
+}
+
+static void soft_batch_release(void* user_data)
+{
+    soft_target_t* target;
+
+    soft_batch_end(draw_list.target);
+    target = (soft_target_t*)user_data;
+    if (target) {
+        soft_pool_free((soft_pool_t*)target->pool);
+        target->pool = NULL;
+    }
+    free(draw_list.cmds);
+    free(draw_list.frees);
+    memset(&draw_list, 0, sizeof(draw_list));
+    return;
+}
+
+// private variables
+const static tex_op_t soft_op = {
+    NULL, // ARGB8888 only
+    soft_module_new,
+    soft_module_begin,
+    soft_module_end,
+    soft_module_sub,
+    soft_module_update,
+    soft_module_alpha,
+    soft_module_free,
+    soft_module_paint,
+    soft_prim_paint,
+    soft_batch_begin,
+    soft_batch_layer,
+    soft_batch_end,
+    soft_batch_release,
+    soft_batch_active
+};
+
+// public functions
+const tex_op_t* tex_get_soft_op()
+{
+    return &soft_op;
+}
+
+void soft_target_init(soft_target_t* target, uint32_t* pixels, int w, int h, int pitch)
+{
+    if (!target)
+        return;
+
+    soft_pick_kernel();
+    target->pixels = pixels;
+    target->w = w;
+    target->h = h;
+    target->pitch = pitch;
+    target->thread_count = 1;
+    target->pool = NULL;
+    soft_target_set_clip(target, 0, 0, w, h);
+    return;
+}
+
+void soft_target_set_clip(soft_target_t* target, int x, int y, int w, int h)
+{
+    int x1, y1;
+
+    if (!target)
+        return;
+
+    x1 = x + w;
+    y1 = y + h;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 > target->w) x1 = target->w;
+    if (y1 > target->h) y1 = target->h;
+
+    target->clip_x = x;
+    target->clip_y = y;
+    target->clip_w = x1 > x ? x1 - x : 0;
+    target->clip_h = y1 > y ? y1 - y : 0;
+    return;
+}
+
+void soft_target_clear(soft_target_t* target, uint32_t color)
+{
+    uint32_t* row;
+
+    if (!target || !target->pixels)
+        return;
+
+    for (int y = target->clip_y; y < target->clip_y + target->clip_h; y++) {
+        row = target->pixels + y * target->pitch + target->clip_x;
+        for (int x = 0; x < target->clip_w; x++) {
+            row[x] = color;
+        }
+    }
+    return;
+}
@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _ENGINE_TEX_SOFT_H_
+#define _ENGINE_TEX_SOFT_H_
+
+#include <stdint.h>
+
+#include "engine_tex_impl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// structs
+
+// caller owned framebuffer, pass it as user_data to the module functions
+typedef struct soft_target_s
+{
+    uint32_t *pixels; // ARGB, the layout module pixels use
+    int w;
+    int h;
+    int pitch;        // in pixels
+
+    // draws are clipped to this rect, the whole buffer by default
+    int clip_x;
+    int clip_y;
+    int clip_w;
+    int clip_h;
+
+    // more than one renders module_batch_end of 64 draws or more in
+    // horizontal bands. the band threads are made on the first such batch
+    // and kept in pool until module_batch_release
+    int thread_count;
+    void *pool;
+} soft_target_t;
+
+// public functions
+void soft_target_init    (soft_target_t *target, uint32_t *pixels, int w, int h, int pitch);
+void soft_target_set_clip(soft_target_t *target, int x, int y, int w, int h);
+void soft_target_clear   (soft_target_t *target, uint32_t color);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
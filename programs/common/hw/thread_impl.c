@@ -0,0 +1,128 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "thread_impl.h"
+
+#include <SDL2/SDL.h>
+
+// thread_t, mutex_t and cond_t are SDL objects in disguise
+
+thread_t* thread_create(thread_func_t func, const char* name, void* arg)
+{
+    if (!func)
+        return NULL;
+
+    // fails on targets built without thread support
+    return (thread_t*)SDL_CreateThread(func, name, arg);
+}
+
+int thread_join(thread_t* thread)
+{
+    int status;
+
+    if (!thread)
+        return -1;
+
+    status = 0;
+    SDL_WaitThread((SDL_Thread*)thread, &status);
+    return status;
+}
+
+int thread_get_cpu_count()
+{
+    return SDL_GetCPUCount();
+}
+
+mutex_t* mutex_create()
+{
+    return (mutex_t*)SDL_CreateMutex();
+}
+
+void mutex_free(mutex_t* mutex)
+{
+    if (!mutex)
+        return;
+
+    SDL_DestroyMutex((SDL_mutex*)mutex);
+    return;
+}
+
+void mutex_lock(mutex_t* mutex)
+{
+    if (!mutex)
+        return;
+
+    SDL_LockMutex((SDL_mutex*)mutex);
+    return;
+}
+
+void mutex_unlock(mutex_t* mutex)
+{
+    if (!mutex)
+        return;
+
+    SDL_UnlockMutex((SDL_mutex*)mutex);
+    return;
+}
+
+cond_t* cond_create()
+{
+    return (cond_t*)SDL_CreateCond();
+}
+
+void cond_free(cond_t* cond)
+{
+    if (!cond)
+        return;
+
+    SDL_DestroyCond((SDL_cond*)cond);
+    return;
+}
+
+void cond_wait(cond_t* cond, mutex_t* mutex)
+{
+    if (!cond || !mutex)
+        return;
+
+    SDL_CondWait((SDL_cond*)cond, (SDL_mutex*)mutex);
+    return;
+}
+
+void cond_signal(cond_t* cond)
+{
+    if (!cond)
+        return;
+
+    SDL_CondSignal((SDL_cond*)cond);
+    return;
+}
+
+void cond_broadcast(cond_t* cond)
+{
+    if (!cond)
+        return;
+
+    SDL_CondBroadcast((SDL_cond*)cond);
+    return;
+}
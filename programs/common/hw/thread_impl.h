@@ -0,0 +1,73 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _THREAD_IMPL_H_
+#define _THREAD_IMPL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// storage each thread gets its own copy of
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// structs
+struct thread_s;
+typedef struct thread_s thread_t;
+
+struct mutex_s;
+typedef struct mutex_s mutex_t;
+
+struct cond_s;
+typedef struct cond_s cond_t;
+
+typedef int (*thread_func_t)(void *arg);
+
+// public functions
+thread_t* thread_create(thread_func_t func, const char *name, void *arg);
+int       thread_join(thread_t *thread);
+int       thread_get_cpu_count();
+
+mutex_t*  mutex_create();
+void      mutex_free(mutex_t *mutex);
+void      mutex_lock(mutex_t *mutex);
+void      mutex_unlock(mutex_t *mutex);
+
+// wait unlocks mutex while it sleeps and locks it again before returning,
+// callers check their condition in a loop
+cond_t*   cond_create();
+void      cond_free(cond_t *cond);
+void      cond_wait(cond_t *cond, mutex_t *mutex);
+void      cond_signal(cond_t *cond);
+void      cond_broadcast(cond_t *cond);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,6 +1,10 @@
 add_library(hw_impl STATIC
     ${CMAKE_CURRENT_LIST_DIR}/hw/engine_tex_impl.c
+    ${CMAKE_CURRENT_LIST_DIR}/hw/engine_tex_null.c
+    ${CMAKE_CURRENT_LIST_DIR}/hw/engine_tex_prim.c
+    ${CMAKE_CURRENT_LIST_DIR}/hw/engine_tex_soft.c
     ${CMAKE_CURRENT_LIST_DIR}/hw/file_impl.c
+    ${CMAKE_CURRENT_LIST_DIR}/hw/thread_impl.c
 )
 
 target_include_directories(hw_impl PUBLIC
@@ -1,4 +1,8 @@
 add_library(sprite STATIC
+    ${CMAKE_CURRENT_LIST_DIR}/sprite/anim.c
+    ${CMAKE_CURRENT_LIST_DIR}/sprite/atlas.c
+    ${CMAKE_CURRENT_LIST_DIR}/sprite/bsprite.c
+    ${CMAKE_CURRENT_LIST_DIR}/sprite/coll_grid.c
     ${CMAKE_CURRENT_LIST_DIR}/sprite/palette.c
     ${CMAKE_CURRENT_LIST_DIR}/sprite/sprite.c
     ${CMAKE_CURRENT_LIST_DIR}/sprite/texture.c
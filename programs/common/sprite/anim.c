@@ -0,0 +1,295 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "anim.h"
+
+#include <stdlib.h> /* malloc, free */
+#include <string.h> /* memset */
+
+// private functions
+static inline int anim_time(const sprite_t* spr, int af_index)
+{
+    int time;
+
+    time = spr->aframes[af_index].time;
+    // a zero time would never advance
+    return time > 0 ? time : 1;
+}
+
+static int anim_duration(const sprite_t* spr, int anim_index)
+{
+    int duration;
+    anim_t* anim;
+
+    anim = &(spr->anims[anim_index]);
+    duration = 0;
+    for (int i = 0; i < anim->count; i++) {
+        duration += anim_time(spr, anim->offset + i);
+    }
+    return duration;
+}
+
+// aframe times of the single player come from the sprite, the batched
+// one keeps a table of them
+typedef int (*anim_time_fn)(const void* src, int af_index);
+
+static inline int anim_sprite_time(const void* src, int af_index)
+{
+    return anim_time((const sprite_t*)src, af_index);
+}
+
+static inline int anim_table_time(const void* src, int af_index)
+{
+    return ((const int*)src)[af_index];
+}
+
+// shared by the single and the batched player, time_of is inlined
+static inline void anim_step(anim_time_fn time_of, const void* src, int first, int length, int duration,
+    int* aframe, int* elapsed, int* loops, int dt)
+{
+    int af;
+    int e;
+    int t;
+
+    if (*loops < 0 || length <= 0)
+        return;
+
+    af = *aframe;
+    e = *elapsed + dt;
+    // skip whole plays at once when looping forever
+    if (*loops == ANIM_LOOP_FOREVER && duration > 0 && e >= duration)
+        e %= duration;
+
+    t = time_of(src, first + af);
+    while (e >= t) {
+        e -= t;
+        if (++af < length) {
+            t = time_of(src, first + af);
+            continue;
+        }
+
+        // end of a play
+        if (*loops == 1) {
+            *loops = -1;
+            af = length - 1;
+            e = 0;
+            break;
+        }
+        if (*loops > 1)
+            (*loops)--;
+        af = 0;
+        t = time_of(src, first);
+    }
+
+    *aframe = af;
+    *elapsed = e;
+    return;
+}
+
+// public functions
+int anim_player_init(anim_player_t* player, sprite_t* spr, int anim_index, int loops)
+{
+    if (!player || !spr || anim_index < 0)
+        return -1;
+    if (anim_index >= spr->anim_count)
+        return -2;
+
+    player->spr = spr;
+    player->anim_index = anim_index;
+    player->aframe = 0;
+    player->elapsed = 0;
+    player->loops = loops > 0 ? loops : ANIM_LOOP_FOREVER;
+    player->duration = anim_duration(spr, anim_index);
+    return 0;
+}
+
+void anim_player_update(anim_player_t* player, int dt)
+{
+    anim_t* anim;
+
+    if (!player || !player->spr || dt <= 0)
+        return;
+
+    anim = &(player->spr->anims[player->anim_index]);
+    anim_step(anim_sprite_time, player->spr, anim->offset, anim->count, player->duration,
+        &player->aframe, &player->elapsed, &player->loops, dt);
+    return;
+}
+
+int anim_player_get_aframe(const anim_player_t* player)
+{
+    if (!player || !player->spr)
+        return -1;
+
+    return player->spr->anims[player->anim_index].offset + player->aframe;
+}
+
+int anim_player_is_done(const anim_player_t* player)
+{
+    if (!player)
+        return 1;
+
+    return player->loops < 0;
+}
+
+void anim_player_draw(const anim_player_t* player, int x, int y, int flip)
+{
+    int af_index;
+
+    af_index = anim_player_get_aframe(player);
+    if (af_index < 0)
+        return;
+
+    sprite_draw_aframe(player->spr, af_index, x, y, flip);
+    return;
+}
+
+anim_players_t* anim_players_new(sprite_t* spr, int capacity)
+{
+    int needed_size;
+    uint8_t* p;
+    anim_players_t* res;
+
+    if (!spr || capacity <= 0)
+        return NULL;
+
+    // one block: header, per instance arrays, times
+    needed_size = sizeof(anim_players_t);
+    needed_size += capacity * 6 * sizeof(int);
+    needed_size += spr->aframe_count * sizeof(int);
+    p = (uint8_t*)malloc(needed_size);
+    if (!p)
+        return NULL;
+    memset(p, 0, needed_size);
+
+    res = (anim_players_t*)p;
+    p += sizeof(anim_players_t);
+    res->first = (int*)p;
+    p += capacity * sizeof(int);
+    res->length = (int*)p;
+    p += capacity * sizeof(int);
+    res->aframe = (int*)p;
+    p += capacity * sizeof(int);
+    res->elapsed = (int*)p;
+    p += capacity * sizeof(int);
+    res->loops = (int*)p;
+    p += capacity * sizeof(int);
+    res->duration = (int*)p;
+    p += capacity * sizeof(int);
+    res->times = (int*)p;
+
+    res->spr = spr;
+    res->capacity = capacity;
+    for (int i = 0; i < spr->aframe_count; i++) {
+        res->times[i] = anim_time(spr, i);
+    }
+    return res;
+}
+
+void anim_players_free(anim_players_t* players)
+{
+    if (!players)
+        return;
+
+    free(players);
+    return;
+}
+
+int anim_players_add(anim_players_t* players, int anim_index, int loops)
+{
+    int id;
+    anim_t* anim;
+
+    if (!players || anim_index < 0)
+        return -1;
+    if (anim_index >= players->spr->anim_count)
+        return -2;
+    if (players->count >= players->capacity)
+        return -3;
+
+    anim = &(players->spr->anims[anim_index]);
+    id = players->count++;
+    players->first[id] = anim->offset;
+    players->length[id] = anim->count;
+    players->aframe[id] = 0;
+    players->elapsed[id] = 0;
+    players->loops[id] = loops > 0 ? loops : ANIM_LOOP_FOREVER;
+    players->duration[id] = anim_duration(players->spr, anim_index);
+    return id;
+}
+
+void anim_players_update(anim_players_t* players, int n, int dt)
+{
+    const int* times;
+    int* first;
+    int* length;
+    int* aframe;
+    int* elapsed;
+    int* loops;
+
+    if (!players || dt <= 0)
+        return;
+    if (n > players->count)
+        n = players->count;
+
+    times = players->times;
+    first = players->first;
+    length = players->length;
+    aframe = players->aframe;
+    elapsed = players->elapsed;
+    loops = players->loops;
+    for (int i = 0; i < n; i++) {
+        int e = elapsed[i] + dt;
+
+        // common case, still inside the current aframe. empty anims have
+        // no time to look at
+        if (length[i] > 0 && loops[i] >= 0 && e < times[first[i] + aframe[i]]) {
+            elapsed[i] = e;
+            continue;
+        }
+        anim_step(anim_table_time, times, first[i], length[i], players->duration[i], &aframe[i],
+            &elapsed[i], &loops[i], dt);
+    }
+    return;
+}
+
+int anim_players_get_aframe(const anim_players_t* players, int id)
+{
+    if (!players || id < 0 || id >= players->count)
+        return -1;
+
+    return players->first[id] + players->aframe[id];
+}
+
+void anim_players_draw(const anim_players_t* players, int id, int x, int y, int flip)
+{
+    int af_index;
+
+    af_index = anim_players_get_aframe(players, id);
+    if (af_index < 0)
+        return;
+
+    sprite_draw_aframe(players->spr, af_index, x, y, flip);
+    return;
+}
@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _ANIM_H_
+#define _ANIM_H_
+
+#include "sprite.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// defines
+#define ANIM_LOOP_FOREVER 0
+
+// structs
+
+// a single animation instance, time is counted in the same ticks as aframe_t.time
+typedef struct anim_player_s
+{
+    sprite_t *spr;
+    int anim_index;
+    int aframe;  // position inside the anim
+    int elapsed; // ticks spent on the current aframe
+    int loops;   // plays left, ANIM_LOOP_FOREVER or -1 once finished
+    int duration; // ticks for one play
+} anim_player_t;
+
+// many instances of one sprite in SoA layout for anim_players_update
+typedef struct anim_players_s
+{
+    sprite_t *spr;
+    int count;
+    int capacity;
+
+    // per instance
+    int *first;   // first aframe of the anim
+    int *length;  // aframes in the anim
+    int *aframe;
+    int *elapsed;
+    int *loops;
+    int *duration; // ticks for one play
+
+    // per aframe of spr, clamped to at least one tick
+    int *times;
+} anim_players_t;
+
+// public functions
+int  anim_player_init      (anim_player_t *player, sprite_t *spr, int anim_index, int loops);
+void anim_player_update    (anim_player_t *player, int dt);
+int  anim_player_get_aframe(const anim_player_t *player);
+int  anim_player_is_done   (const anim_player_t *player);
+void anim_player_draw      (const anim_player_t *player, int x, int y, int flip);
+
+anim_players_t* anim_players_new(sprite_t *spr, int capacity);
+void            anim_players_free(anim_players_t *players);
+
+// returns the instance id or a negative value when full
+int  anim_players_add       (anim_players_t *players, int anim_index, int loops);
+void anim_players_update    (anim_players_t *players, int n, int dt);
+int  anim_players_get_aframe(const anim_players_t *players, int id);
+void anim_players_draw      (const anim_players_t *players, int id, int x, int y, int flip);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,334 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "atlas.h"
+
+#include <string.h> /* memset, memcpy */
+
+#include "engine_tex_impl.h"
+#include "texture.h"
+
+// keep neighbours from bleeding in when the renderer scales
+#define ATLAS_PADDING 1
+
+// private structs
+typedef struct atlas_entry_s {
+    sprite_t* spr;
+    int module_index;
+    int pal_index;
+    int w, h;
+    int seq;
+    int page;
+    int x, y;
+    void* view;   // handed to spr, NULL when it got none
+} atlas_entry_t;
+
+struct atlas_s {
+    int page_w, page_h;
+    const tex_op_t* tex_op; // taken from the first sprite added
+    void* user_data;
+    int format;             // 32-bit TEX_FORMAT_*, pages mix sprites of any palette
+
+    int entry_count;
+    int entry_capacity;
+    atlas_entry_t* entries;
+
+    int page_count;
+    void** pages;
+};
+
+// private functions
+static int atlas_entry_cmp(const void* a, const void* b)
+{
+    const atlas_entry_t* ea = (const atlas_entry_t*)a;
+    const atlas_entry_t* eb = (const atlas_entry_t*)b;
+
+    // tallest first gives tight shelves
+    if (ea->h != eb->h)
+        return eb->h - ea->h;
+    if (ea->w != eb->w)
+        return eb->w - ea->w;
+    return ea->seq - eb->seq;
+}
+
+static int atlas_pack(atlas_t* atlas)
+{
+    int page;
+    int cur_x;
+    int shelf_y, shelf_h;
+    atlas_entry_t* e;
+
+    page = 0;
+    cur_x = 0;
+    shelf_y = 0;
+    shelf_h = 0;
+    for (int i = 0; i < atlas->entry_count; i++) {
+        e = &(atlas->entries[i]);
+        if (cur_x + e->w > atlas->page_w) {
+            shelf_y += shelf_h;
+            cur_x = 0;
+            shelf_h = 0;
+        }
+        if (shelf_y + e->h > atlas->page_h) {
+            page++;
+            shelf_y = 0;
+            cur_x = 0;
+            shelf_h = 0;
+        }
+
+        e->page = page;
+        e->x = cur_x;
+        e->y = shelf_y;
+        cur_x += e->w + ATLAS_PADDING;
+        if (e->h + ATLAS_PADDING > shelf_h)
+            shelf_h = e->h + ATLAS_PADDING;
+    }
+    return page + 1;
+}
+
+// pixels of one page: backend memory from module_begin, else a shared buffer.
+// other texels than ARGB are converted in place, so only ARGB pages go to
+// memory that is written and never read back
+static void* atlas_page_begin(atlas_t* atlas, int used_h, uint32_t* buffer, uint32_t** pixels, int* stride)
+{
+    void* page;
+    int pitch;
+
+    page = NULL;
+    *pixels = buffer;
+    *stride = atlas->page_w;
+    if (atlas->tex_op->module_begin && atlas->format == TEX_FORMAT_ARGB8888) {
+        page = atlas->tex_op->module_begin(atlas->page_w, used_h, atlas->format, (void**)pixels, &pitch, atlas->user_data);
+        if (page)
+            *stride = pitch / 4;
+        else
+            *pixels = buffer;
+    }
+
+    // padding and shelf gaps stay transparent
+    for (int y = 0; y < used_h; y++) {
+        memset(*pixels + y * *stride, 0, atlas->page_w * sizeof(uint32_t));
+    }
+    return page;
+}
+
+// public functions
+atlas_t* atlas_new(int page_w, int page_h, void* user_data)
+{
+    atlas_t* res;
+
+    if (page_w <= 0 || page_h <= 0)
+        return NULL;
+
+    res = (atlas_t*)calloc(1, sizeof(atlas_t));
+    if (!res)
+        return NULL;
+
+    res->page_w = page_w;
+    res->page_h = page_h;
+    res->user_data = user_data;
+    return res;
+}
+
+int atlas_add_sprite(atlas_t* atlas, sprite_t* spr, int pal_index)
+{
+    dim_t* dim;
+    atlas_entry_t* e;
+
+    if (!atlas || !spr || pal_index < 0)
+        return -1;
+    if (pal_index >= spr->palette_count)
+        return -2;
+    if (atlas->pages)
+        return -3;
+    // views must come from the backend the sprite frees its modules with
+    if (atlas->tex_op && atlas->tex_op != spr->tex_op)
+        return -5;
+    atlas->tex_op = spr->tex_op;
+
+    for (int i = 0; i < spr->module_count; i++) {
+        dim = &(spr->module_dims[i]);
+        // too big for a page, keeps its own texture
+        if (dim->w <= 0 || dim->h <= 0)
+            continue;
+        if (dim->w > atlas->page_w || dim->h > atlas->page_h)
+            continue;
+        // known to draw nothing, no room needed
+        if (sprite_get_module_alpha(spr, i, pal_index) == TEX_ALPHA_EMPTY)
+            continue;
+
+        if (atlas->entry_count >= atlas->entry_capacity) {
+            int capacity = atlas->entry_capacity ? atlas->entry_capacity * 2 : 64;
+            e = (atlas_entry_t*)realloc(atlas->entries, capacity * sizeof(atlas_entry_t));
+            if (!e)
+                return -4;
+            atlas->entries = e;
+            atlas->entry_capacity = capacity;
+        }
+
+        e = &(atlas->entries[atlas->entry_count]);
+        e->spr = spr;
+        e->module_index = i;
+        e->pal_index = pal_index;
+        e->w = dim->w;
+        e->h = dim->h;
+        e->seq = atlas->entry_count;
+        e->view = NULL;
+        atlas->entry_count++;
+    }
+    return 0;
+}
+
+int atlas_build(atlas_t* atlas)
+{
+    int begin, end;
+    int used_h;
+    int page_count;
+    int stride;
+    uint32_t* buffer;
+    uint32_t* pixels;
+    atlas_entry_t* e;
+
+    if (!atlas)
+        return -1;
+    if (atlas->pages)
+        return -2;
+    if (!atlas->entry_count)
+        return 0;
+
+    qsort(atlas->entries, atlas->entry_count, sizeof(atlas_entry_t), atlas_entry_cmp);
+    page_count = atlas_pack(atlas);
+    atlas->format = texture_pick_format(atlas->tex_op, atlas->user_data, PIXEL_FORMAT_8888);
+
+    atlas->pages = (void**)calloc(page_count, sizeof(void*));
+    buffer = (uint32_t*)malloc(atlas->page_w * atlas->page_h * sizeof(uint32_t));
+    if (!atlas->pages || !buffer) {
+        if (buffer)
+            free(buffer);
+        return -3;
+    }
+    atlas->page_count = page_count;
+
+    // entries of a page are contiguous after packing
+    begin = 0;
+    for (int page = 0; page < page_count; page++) {
+        void* tex;
+
+        used_h = 0;
+        for (end = begin; end < atlas->entry_count; end++) {
+            e = &(atlas->entries[end]);
+            if (e->page != page)
+                break;
+            if (e->y + e->h > used_h)
+                used_h = e->y + e->h;
+        }
+        if (!used_h) {
+            begin = end;
+            continue;
+        }
+
+        // modules decode straight into their place on the page
+        tex = atlas_page_begin(atlas, used_h, buffer, &pixels, &stride);
+        for (int i = begin; i < end; i++) {
+            e = &(atlas->entries[i]);
+            if (sprite_get_module_pixels_to(e->spr, e->module_index, e->pal_index,
+                    pixels + e->y * stride + e->x, stride * (int)sizeof(uint32_t)))
+                e->page = -1;
+        }
+        for (int y = 0; y < used_h; y++) {
+            texture_to_texels(pixels + y * stride, atlas->page_w, atlas->format);
+        }
+
+        if (tex) {
+            if (atlas->tex_op->module_end(tex, atlas->user_data)) {
+                atlas->tex_op->module_free(tex, atlas->user_data);
+                tex = NULL;
+            }
+        } else {
+            tex = atlas->tex_op->module_new(pixels, atlas->page_w, used_h, atlas->format, atlas->user_data);
+        }
+        atlas->pages[page] = tex;
+
+        if (atlas->pages[page]) {
+            for (int i = begin; i < end; i++) {
+                int alpha;
+                void* view;
+
+                e = &(atlas->entries[i]);
+                if (e->page != page)
+                    continue;
+                view = atlas->tex_op->module_sub(atlas->pages[page], e->x, e->y, e->w, e->h, atlas->user_data);
+                if (!view)
+                    continue;
+                // the page itself stays blended, views may know better
+                alpha = sprite_get_module_alpha(e->spr, e->module_index, e->pal_index);
+                if (alpha != TEX_ALPHA_UNKNOWN && atlas->tex_op->module_alpha)
+                    atlas->tex_op->module_alpha(view, alpha, atlas->user_data);
+                if (sprite_set_module(e->spr, e->module_index, e->pal_index, view)) {
+                    atlas->tex_op->module_free(view, atlas->user_data);
+                    continue;
+                }
+                e->view = view;
+            }
+        }
+        begin = end;
+    }
+
+    free(buffer);
+    return 0;
+}
+
+int atlas_get_page_count(atlas_t* atlas)
+{
+    if (!atlas)
+        return 0;
+
+    return atlas->page_count;
+}
+
+void atlas_free(atlas_t* atlas)
+{
+    atlas_entry_t* e;
+
+    if (!atlas)
+        return;
+
+    // views point into the pages, take back the ones sprites still draw
+    // with. modules replaced since then are left alone
+    for (int i = 0; i < atlas->entry_count; i++) {
+        e = &(atlas->entries[i]);
+        if (e->view && sprite_get_module(e->spr, e->module_index, e->pal_index) == e->view)
+            sprite_set_module(e->spr, e->module_index, e->pal_index, NULL);
+    }
+    for (int i = 0; i < atlas->page_count; i++) {
+        if (atlas->pages[i])
+            atlas->tex_op->module_free(atlas->pages[i], atlas->user_data);
+    }
+    if (atlas->pages)
+        free(atlas->pages);
+    if (atlas->entries)
+        free(atlas->entries);
+    free(atlas);
+    return;
+}
@@ -0,0 +1,61 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _ATLAS_H_
+#define _ATLAS_H_
+
+#include "sprite.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// structs
+struct atlas_s;
+typedef struct atlas_s atlas_t;
+
+// public functions
+
+// pages are page_w * page_h at most, user_data is handed to module_new
+atlas_t* atlas_new         (int page_w, int page_h, void *user_data);
+
+// queue every module of spr for palette pal_index, call it once per
+// sprite (or per sprite of a chunk) before atlas_build. all sprites of
+// an atlas must be loaded with the same tex_op
+int      atlas_add_sprite  (atlas_t *atlas, sprite_t *spr, int pal_index);
+
+// shelf-pack the queued modules into pages and hand each sprite a view
+// on its region
+int      atlas_build       (atlas_t *atlas);
+int      atlas_get_page_count(atlas_t *atlas);
+
+// takes its views back from the sprites, those decode their own modules
+// again on the next draw. free the atlas before the sprites it was built for
+void     atlas_free        (atlas_t *atlas);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,394 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bsprite.h"
+
+#include <string.h> /* memset */
+
+// defines
+
+// what a file may ask for, the rest stores images some other way
+#define BS_SUPPORTED_V003 (BS_MODULES | BS_MODULES_XY | BS_MODULES_IMG | BS_MODULES_WH_SHORT | \
+                           BS_MODULES_XY_SHORT | BS_MODULES_USAGE | BS_FRAMES | BS_NO_FM_START | \
+                           BS_FM_OFF_SHORT | BS_NFM_SHORT | BS_SKIP_FRAME_RC | BS_FRAME_COLL_RC | \
+                           BS_FM_PALETTE | BS_FRAME_RECTS | BS_ANIMS | BS_NO_AF_START | \
+                           BS_AF_OFF_SHORT | BS_NAF_SHORT | BS_MODULE_IMAGES_FX | BS_MODULE_IMAGES | \
+                           BS_PNG_CRC | BS_KEEP_PAL | BS_TRANSP_FIRST | BS_TRANSP_LAST)
+#define BS_SUPPORTED_V005 (BS_SUPPORTED_V003 | BS_FM_INDEX_SHORT | BS_AF_INDEX_SHORT | BS_IMAGE_SIZE_INT)
+#define BS_REQUIRED       (BS_MODULES | BS_MODULE_IMAGES)
+
+// index bits 8 and 9 of one byte fmodule and aframe indices sit in their flags
+#define BS_INDEX_EX_MASK  0xC0
+#define BS_INDEX_EX_SHIFT 2
+
+// little endian fields, n is a constant 1 or 2 in every expansion below
+// so each reader keeps one load per field and no branch
+#define BS_U(p, n) ((n) == 1 ? (int)(p)[0] : (int)((p)[0] | (p)[1] << 8))
+#define BS_S(p, n) ((n) == 1 ? (int)(int8_t)(p)[0] : (int)(int16_t)((p)[0] | (p)[1] << 8))
+
+// private functions
+
+// one reader per field width combination, named by the widths
+#define BS_DIMS_READER(WH)                                                              \
+    static void bs_read_dims_##WH(const uint8_t* src, int count, int stride, dim_t* out) \
+    {                                                                                   \
+        for (int i = 0; i < count; i++, src += stride) {                                \
+            out[i].w = BS_U(src, WH);                                                   \
+            out[i].h = BS_U(src + WH, WH);                                              \
+        }                                                                               \
+        return;                                                                         \
+    }
+
+// index, x, y, [palette,] flags
+#define BS_FMODULES_READER(IDX, OFF, PAL)                                                         \
+    static void bs_read_fmodules_##IDX##OFF##PAL(const uint8_t* src, int count, fmodule_t* out) \
+    {                                                                                             \
+        for (int i = 0; i < count; i++, src += IDX + 2 * OFF + PAL + 1) {                         \
+            int flags = src[IDX + 2 * OFF + PAL];                                                 \
+                                                                                                  \
+            out[i].module_index = BS_U(src, IDX);                                                 \
+            out[i].x = BS_S(src + IDX, OFF);                                                      \
+            out[i].y = BS_S(src + IDX + OFF, OFF);                                                \
+            out[i].flip = flags;                                                                  \
+            if (IDX == 1) {                                                                       \
+                out[i].module_index |= (flags & BS_INDEX_EX_MASK) << BS_INDEX_EX_SHIFT;           \
+                out[i].flip = flags & ~BS_INDEX_EX_MASK;                                          \
+            }                                                                                     \
+        }                                                                                         \
+        return;                                                                                   \
+    }
+
+// count, [first,] [rect count], without first the frames follow each other
+#define BS_FRAMES_READER(NFM, START, RECTS)                                                    \
+    static void bs_read_frames_##NFM##START##RECTS(const uint8_t* src, int count, frame_t* out) \
+    {                                                                                          \
+        int next = 0;                                                                          \
+                                                                                               \
+        for (int i = 0; i < count; i++, src += NFM + START + RECTS) {                          \
+            out[i].count = BS_U(src, NFM);                                                     \
+            out[i].offset = START ? BS_U(src + NFM, 2) : next;                                 \
+            next = out[i].offset + out[i].count;                                               \
+        }                                                                                      \
+        return;                                                                                \
+    }
+
+// x, y, w, h
+#define BS_RECTS_READER(R)                                                           \
+    static void bs_read_rects_##R(const uint8_t* src, int count, frame_rect_t* out) \
+    {                                                                                \
+        for (int i = 0; i < count; i++, src += 4 * R) {                              \
+            out[i].x = BS_S(src, R);                                                 \
+            out[i].y = BS_S(src + R, R);                                             \
+            out[i].w = BS_U(src + 2 * R, R);                                         \
+            out[i].h = BS_U(src + 3 * R, R);                                         \
+        }                                                                            \
+        return;                                                                      \
+    }
+
+// frame index, time, x, y, flags
+#define BS_AFRAMES_READER(IDX, OFF)                                                        \
+    static void bs_read_aframes_##IDX##OFF(const uint8_t* src, int count, aframe_t* out) \
+    {                                                                                      \
+        for (int i = 0; i < count; i++, src += IDX + 2 * OFF + 2) {                        \
+            int flags = src[IDX + 1 + 2 * OFF];                                            \
+                                                                                           \
+            out[i].frame_index = BS_U(src, IDX);                                           \
+            out[i].time = src[IDX];                                                        \
+            out[i].x = BS_S(src + IDX + 1, OFF);                                           \
+            out[i].y = BS_S(src + IDX + 1 + OFF, OFF);                                     \
+            out[i].flip = flags;                                                           \
+            if (IDX == 1) {                                                                \
+                out[i].frame_index |= (flags & BS_INDEX_EX_MASK) << BS_INDEX_EX_SHIFT;     \
+                out[i].flip = flags & ~BS_INDEX_EX_MASK;                                   \
+            }                                                                              \
+        }                                                                                  \
+        return;                                                                            \
+    }
+
+// count, [first], without first the anims follow each other
+#define BS_ANIMS_READER(NAF, START)                                                  \
+    static void bs_read_anims_##NAF##START(const uint8_t* src, int count, anim_t* out) \
+    {                                                                                \
+        int next = 0;                                                                \
+                                                                                     \
+        for (int i = 0; i < count; i++, src += NAF + START) {                        \
+            out[i].count = BS_U(src, NAF);                                           \
+            out[i].offset = START ? BS_U(src + NAF, 2) : next;                       \
+            next = out[i].offset + out[i].count;                                     \
+        }                                                                            \
+        return;                                                                      \
+    }
+
+BS_DIMS_READER(1)
+BS_DIMS_READER(2)
+
+BS_FMODULES_READER(1, 1, 0)
+BS_FMODULES_READER(1, 1, 1)
+BS_FMODULES_READER(1, 2, 0)
+BS_FMODULES_READER(1, 2, 1)
+BS_FMODULES_READER(2, 1, 0)
+BS_FMODULES_READER(2, 1, 1)
+BS_FMODULES_READER(2, 2, 0)
+BS_FMODULES_READER(2, 2, 1)
+
+BS_FRAMES_READER(1, 0, 0)
+BS_FRAMES_READER(1, 0, 1)
+BS_FRAMES_READER(1, 2, 0)
+BS_FRAMES_READER(1, 2, 1)
+BS_FRAMES_READER(2, 0, 0)
+BS_FRAMES_READER(2, 0, 1)
+BS_FRAMES_READER(2, 2, 0)
+BS_FRAMES_READER(2, 2, 1)
+
+BS_RECTS_READER(1)
+BS_RECTS_READER(2)
+
+BS_AFRAMES_READER(1, 1)
+BS_AFRAMES_READER(1, 2)
+BS_AFRAMES_READER(2, 1)
+BS_AFRAMES_READER(2, 2)
+
+BS_ANIMS_READER(1, 0)
+BS_ANIMS_READER(1, 2)
+BS_ANIMS_READER(2, 0)
+BS_ANIMS_READER(2, 2)
+
+// global variables
+
+// indexed by field width - 1, then by the optional field being there
+static const bs_read_dims_fn dims_readers[2] = {
+    bs_read_dims_1, bs_read_dims_2
+};
+
+static const bs_read_fmodules_fn fmodules_readers[2][2][2] = {
+    { { bs_read_fmodules_110, bs_read_fmodules_111 }, { bs_read_fmodules_120, bs_read_fmodules_121 } },
+    { { bs_read_fmodules_210, bs_read_fmodules_211 }, { bs_read_fmodules_220, bs_read_fmodules_221 } }
+};
+
+static const bs_read_frames_fn frames_readers[2][2][2] = {
+    { { bs_read_frames_100, bs_read_frames_101 }, { bs_read_frames_120, bs_read_frames_121 } },
+    { { bs_read_frames_200, bs_read_frames_201 }, { bs_read_frames_220, bs_read_frames_221 } }
+};
+
+static const bs_read_rects_fn rects_readers[2] = {
+    bs_read_rects_1, bs_read_rects_2
+};
+
+static const bs_read_aframes_fn aframes_readers[2][2] = {
+    { bs_read_aframes_11, bs_read_aframes_12 },
+    { bs_read_aframes_21, bs_read_aframes_22 }
+};
+
+static const bs_read_anims_fn anims_readers[2][2] = {
+    { bs_read_anims_10, bs_read_anims_12 },
+    { bs_read_anims_20, bs_read_anims_22 }
+};
+
+// tex_prim_t type of a module record starting with first, 0 for images
+static int bs_prim_type(const bs_layout_t* layout, uint8_t first)
+{
+    switch (first) {
+    case BS_MD_RECT:
+        return TEX_PRIM_RECT;
+    case BS_MD_FILL_RECT:
+        return TEX_PRIM_FILL_RECT;
+    }
+    // v3 has the rects only, its image records start with their fields
+    if (layout->version != BSPRITE_V005)
+        return 0;
+
+    switch (first) {
+    case BS_MD_MARKER:
+        return BS_PRIM_MARKER;
+    case BS_MD_ARC:
+        return TEX_PRIM_ARC;
+    case BS_MD_FILL_ARC:
+        return TEX_PRIM_FILL_ARC;
+    case BS_MD_TRIANGLE:
+        return TEX_PRIM_TRIANGLE;
+    case BS_MD_FILL_TRIANGLE:
+        return TEX_PRIM_FILL_TRIANGLE;
+    }
+    return 0;
+}
+
+// public functions
+int bs_module_size(const bs_layout_t* layout, uint8_t first)
+{
+    int wh;
+
+    wh = (layout->flags & BS_MODULES_WH_SHORT) ? 2 : 1;
+    switch (bs_prim_type(layout, first)) {
+    case BS_PRIM_MARKER:
+        return 1 + 2 * wh;
+    case TEX_PRIM_RECT:
+    case TEX_PRIM_FILL_RECT:
+        return 1 + 4 + 2 * wh;
+    case TEX_PRIM_ARC:
+    case TEX_PRIM_FILL_ARC:
+        return 1 + 4 + 2 * wh + 4;
+    case TEX_PRIM_TRIANGLE:
+    case TEX_PRIM_FILL_TRIANGLE:
+        return 1 + 4 + 8;
+    }
+    if (!bs_module_image(layout, first))
+        return 0;
+    return layout->module_size;
+}
+
+int bs_module_image(const bs_layout_t* layout, uint8_t first)
+{
+    if (bs_prim_type(layout, first))
+        return 0;
+    return layout->version != BSPRITE_V005 || first == BS_MD_IMAGE;
+}
+
+int bs_read_prim(const bs_layout_t* layout, const uint8_t* src, tex_prim_t* out)
+{
+    int wh;
+    int type;
+    int min_x, min_y, max_x, max_y;
+
+    type = bs_prim_type(layout, src[0]);
+    if (!type)
+        return 0;
+
+    memset(out, 0, sizeof(tex_prim_t));
+    out->type = type;
+    wh = (layout->flags & BS_MODULES_WH_SHORT) ? 2 : 1;
+    if (type == BS_PRIM_MARKER) {
+        out->w = BS_U(src + 1, wh);
+        out->h = BS_U(src + 1 + wh, wh);
+        return 1;
+    }
+
+    // J2ME colors ignore the top byte and exporters leave it 0
+    out->color = src[1] | src[2] << 8 | src[3] << 16 | (uint32_t)src[4] << 24;
+    if (!(out->color >> 24))
+        out->color |= 0xFF000000;
+    src += 5;
+    if (type != TEX_PRIM_TRIANGLE && type != TEX_PRIM_FILL_TRIANGLE) {
+        out->w = BS_U(src, wh);
+        out->h = BS_U(src + wh, wh);
+        if (type == TEX_PRIM_ARC || type == TEX_PRIM_FILL_ARC) {
+            out->start = BS_S(src + 2 * wh, 2);
+            out->arc = BS_S(src + 2 * wh + 2, 2);
+        }
+        return 1;
+    }
+
+    // the first corner is the module origin, the box starts at the
+    // smallest corner so the origin ends up at (x[0], y[0])
+    out->x[1] = BS_S(src, 2);
+    out->y[1] = BS_S(src + 2, 2);
+    out->x[2] = BS_S(src + 4, 2);
+    out->y[2] = BS_S(src + 6, 2);
+    min_x = max_x = min_y = max_y = 0;
+    for (int i = 1; i < 3; i++) {
+        if (out->x[i] < min_x) min_x = out->x[i];
+        if (out->x[i] > max_x) max_x = out->x[i];
+        if (out->y[i] < min_y) min_y = out->y[i];
+        if (out->y[i] > max_y) max_y = out->y[i];
+    }
+    for (int i = 0; i < 3; i++) {
+        out->x[i] -= min_x;
+        out->y[i] -= min_y;
+    }
+    out->w = max_x - min_x + 1;
+    out->h = max_y - min_y + 1;
+    return 1;
+}
+
+int bs_layout_init(bs_layout_t* layout, uint16_t version, uint32_t flags)
+{
+    int wh;
+    int xy;
+    int fm_index;
+    int fm_off;
+    int fm_pal;
+    int nfm;
+    int fm_start;
+    int frame_rects;
+    int rect;
+    int af_index;
+    int af_off;
+    int naf;
+    int af_start;
+
+    if (!layout)
+        return -1;
+
+    switch (version) {
+    case BSPRITE_V003:
+        if (flags & ~BS_SUPPORTED_V003)
+            return -1;
+        // v3 has the 1 byte flags where v5 has the short ones
+        nfm = (flags & BS_NFM_SHORT) ? 1 : 2;
+        naf = (flags & BS_NAF_SHORT) ? 1 : 2;
+        break;
+    case BSPRITE_V005:
+        if (flags & ~BS_SUPPORTED_V005)
+            return -1;
+        nfm = (flags & BS_NFM_SHORT) ? 2 : 1;
+        naf = (flags & BS_NAF_SHORT) ? 2 : 1;
+        break;
+    default:
+        return -1;
+    }
+    if ((flags & BS_REQUIRED) != BS_REQUIRED)
+        return -1;
+
+    wh = (flags & BS_MODULES_WH_SHORT) ? 2 : 1;
+    xy = (flags & BS_MODULES_XY_SHORT) ? 4 : (flags & BS_MODULES_XY) ? 2 : 0;
+    fm_index = (flags & BS_FM_INDEX_SHORT) ? 2 : 1;
+    fm_off = (flags & BS_FM_OFF_SHORT) ? 2 : 1;
+    fm_pal = (flags & BS_FM_PALETTE) ? 1 : 0;
+    fm_start = (flags & BS_NO_FM_START) ? 0 : 2;
+    frame_rects = (flags & BS_FRAME_RECTS) ? 1 : 0;
+    // rects take the width of the fmodule offsets
+    rect = fm_off;
+    af_index = (flags & BS_AF_INDEX_SHORT) ? 2 : 1;
+    af_off = (flags & BS_AF_OFF_SHORT) ? 2 : 1;
+    af_start = (flags & BS_NO_AF_START) ? 0 : 2;
+
+    layout->version = version;
+    layout->flags = flags;
+    // v5 image modules start with their 0 type byte
+    layout->module_head = (version == BSPRITE_V005 ? 1 : 0) + ((flags & BS_MODULES_IMG) ? 1 : 0) + xy;
+    layout->module_size = layout->module_head + 2 * wh;
+    layout->fmodule_size = fm_index + 2 * fm_off + fm_pal + 1;
+    layout->frame_size = nfm + fm_start + frame_rects;
+    layout->rect_size = 4 * rect;
+    layout->aframe_size = af_index + 1 + 2 * af_off + 1;
+    layout->anim_size = naf + af_start;
+    layout->image_size_len = (flags & BS_IMAGE_SIZE_INT) ? 4 : 2;
+
+    layout->read_dims = dims_readers[wh - 1];
+    layout->read_fmodules = fmodules_readers[fm_index - 1][fm_off - 1][fm_pal];
+    layout->read_frames = frames_readers[nfm - 1][fm_start / 2][frame_rects];
+    layout->read_rects = rects_readers[rect - 1];
+    layout->read_aframes = aframes_readers[af_index - 1][af_off - 1];
+    layout->read_anims = anims_readers[naf - 1][af_start / 2];
+    return 0;
+}
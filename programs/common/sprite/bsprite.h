@@ -0,0 +1,140 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _BSPRITE_H_
+#define _BSPRITE_H_
+
+#include <stdint.h>
+#include "sprite.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// defines, see bsprite/bsprite_v3.txt and bsprite/bsprite_v5.txt
+#define BSPRITE_V003 0x03DF
+#define BSPRITE_V005 0x05DF
+
+#define BS_MODULES              (1 <<  0)
+#define BS_MODULES_XY           (1 <<  1)
+#define BS_MODULES_IMG          (1 <<  2)
+#define BS_MODULE_IMAGES_TC_BMP (1 <<  3)
+#define BS_MODULES_WH_SHORT     (1 <<  4)
+#define BS_MODULES_XY_SHORT     (1 <<  5)
+#define BS_MODULES_USAGE        (1 <<  6)
+#define BS_IMAGE_SIZE_INT       (1 <<  7)
+#define BS_FRAMES               (1 <<  8)
+#define BS_NO_FM_START          (1 <<  9)
+#define BS_FM_OFF_SHORT         (1 << 10)
+#define BS_NFM_SHORT            (1 << 11) // BS_NFM_1_BYTE in v3
+#define BS_SKIP_FRAME_RC        (1 << 12)
+#define BS_FRAME_COLL_RC        (1 << 13)
+#define BS_FM_PALETTE           (1 << 14)
+#define BS_FRAME_RECTS          (1 << 15)
+#define BS_ANIMS                (1 << 16)
+#define BS_NO_AF_START          (1 << 17)
+#define BS_AF_OFF_SHORT         (1 << 18)
+#define BS_NAF_SHORT            (1 << 19) // BS_NAF_1_BYTE in v3
+#define BS_FM_INDEX_SHORT       (1 << 20)
+#define BS_AF_INDEX_SHORT       (1 << 21)
+#define BS_EXTRA_FLAGS          (1 << 22)
+#define BS_MODULE_IMAGES_FX     (1 << 23)
+#define BS_MODULE_IMAGES        (1 << 24)
+#define BS_PNG_CRC              (1 << 25)
+#define BS_KEEP_PAL             (1 << 26)
+#define BS_TRANSP_FIRST         (1 << 27)
+#define BS_TRANSP_LAST          (1 << 28)
+#define BS_SINGLE_IMAGE         (1 << 29)
+#define BS_MULTIPLE_IMAGES      (1 << 30)
+#define BS_GIF_HEADER           (1u << 31)
+
+// first byte of a module record, v3 has the two rects only and no byte
+// in front of images
+#define BS_MD_IMAGE             0x00
+#define BS_MD_FILL_TRIANGLE     0xF9
+#define BS_MD_TRIANGLE          0xFA
+#define BS_MD_FILL_ARC          0xFB
+#define BS_MD_ARC               0xFC
+#define BS_MD_MARKER            0xFD
+#define BS_MD_FILL_RECT         0xFE
+#define BS_MD_RECT              0xFF
+
+// longest module record, the arcs and triangles
+#define BS_MODULE_MAX_SIZE      13
+
+// tex_prim_t type of markers, a box for the game that draws nothing
+#define BS_PRIM_MARKER          (-1)
+
+// structs
+typedef void (*bs_read_dims_fn)(const uint8_t *src, int count, int stride, dim_t *out);
+typedef void (*bs_read_fmodules_fn)(const uint8_t *src, int count, fmodule_t *out);
+typedef void (*bs_read_frames_fn)(const uint8_t *src, int count, frame_t *out);
+typedef void (*bs_read_rects_fn)(const uint8_t *src, int count, frame_rect_t *out);
+typedef void (*bs_read_aframes_fn)(const uint8_t *src, int count, aframe_t *out);
+typedef void (*bs_read_anims_fn)(const uint8_t *src, int count, anim_t *out);
+
+// record sizes of one file and the readers made for its field widths,
+// every reader walks count records of raw little endian file bytes
+typedef struct bs_layout_s
+{
+    uint16_t version;
+    uint32_t flags;
+
+    int module_head;    // bytes of an image module before its w and h
+    int module_size;
+    int fmodule_size;
+    int frame_size;
+    int rect_size;      // bound, collision and frame rects
+    int aframe_size;
+    int anim_size;
+    int image_size_len; // bytes of the data size in front of each module image
+
+    bs_read_dims_fn     read_dims; // stride is the distance between two w
+    bs_read_fmodules_fn read_fmodules;
+    bs_read_frames_fn   read_frames;
+    bs_read_rects_fn    read_rects;
+    bs_read_aframes_fn  read_aframes;
+    bs_read_anims_fn    read_anims;
+} bs_layout_t;
+
+// public functions
+
+// fill layout for a file with this header, 0 on success, -1 for versions
+// and flags that store things the loader does not read
+int bs_layout_init(bs_layout_t *layout, uint16_t version, uint32_t flags);
+
+// bytes of the module record starting with first, 0 when none does
+int bs_module_size(const bs_layout_t *layout, uint8_t first);
+// 1 when the module record starting with first is an image one
+int bs_module_image(const bs_layout_t *layout, uint8_t first);
+// 1 with out filled when the module record at src is a shape or a marker,
+// 0 for image records, those are for read_dims. triangle corners are moved
+// to start their box at 0, (x[0], y[0]) is where the module origin went
+int bs_read_prim(const bs_layout_t *layout, const uint8_t *src, tex_prim_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "coll_grid.h"
+
+#include <string.h> /* memset */
+
+// private struct
+typedef struct coll_item_s {
+    frame_rect_t rect;
+    int id;
+    int stamp; // last query that reported this item
+} coll_item_t;
+
+typedef struct coll_cell_s {
+    int cx, cy;
+    int item;
+    int next; // next cell entry of the same bucket, -1 ends
+} coll_cell_t;
+
+struct coll_grid_s {
+    int cell_size;
+    int bucket_count;
+    int* buckets; // first cell entry, -1 for none
+
+    int item_count;
+    int item_capacity;
+    coll_item_t* items;
+
+    int cell_count;
+    int cell_capacity;
+    coll_cell_t* cells;
+
+    int stamp;
+};
+
+// private functions
+static inline int coll_floor_div(int v, int d)
+{
+    return v >= 0 ? v / d : -((-v + d - 1) / d);
+}
+
+static inline int coll_hash(const coll_grid_t* grid, int cx, int cy)
+{
+    uint32_t h;
+
+    h = (uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u;
+    return (int)(h % (uint32_t)grid->bucket_count);
+}
+
+static inline int coll_overlap(const frame_rect_t* a, const frame_rect_t* b)
+{
+    return a->x < b->x + b->w && b->x < a->x + a->w
+        && a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+static int coll_grow(void** array, int* capacity, int needed, int size)
+{
+    int new_capacity;
+    void* p;
+
+    if (needed <= *capacity)
+        return 0;
+
+    new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    p = realloc(*array, (size_t)new_capacity * size);
+    if (!p)
+        return -1;
+
+    *array = p;
+    *capacity = new_capacity;
+    return 0;
+}
+
+// public functions
+coll_grid_t* coll_grid_new(int cell_size, int bucket_count)
+{
+    coll_grid_t* res;
+
+    if (cell_size <= 0 || bucket_count <= 0)
+        return NULL;
+
+    res = (coll_grid_t*)calloc(1, sizeof(coll_grid_t));
+    if (!res)
+        return NULL;
+
+    res->buckets = (int*)malloc(bucket_count * sizeof(int));
+    if (!res->buckets) {
+        free(res);
+        return NULL;
+    }
+
+    res->cell_size = cell_size;
+    res->bucket_count = bucket_count;
+    coll_grid_clear(res);
+    return res;
+}
+
+void coll_grid_free(coll_grid_t* grid)
+{
+    if (!grid)
+        return;
+
+    free(grid->buckets);
+    free(grid->items);
+    free(grid->cells);
+    free(grid);
+    return;
+}
+
+void coll_grid_clear(coll_grid_t* grid)
+{
+    if (!grid)
+        return;
+
+    memset(grid->buckets, 0xFF, grid->bucket_count * sizeof(int));
+    grid->item_count = 0;
+    grid->cell_count = 0;
+    return;
+}
+
+int coll_grid_insert(coll_grid_t* grid, int id, const frame_rect_t* rect)
+{
+    int item;
+    int bucket;
+    int cx0, cy0, cx1, cy1;
+    coll_cell_t* cell;
+
+    if (!grid || !rect)
+        return -1;
+    if (rect->w <= 0 || rect->h <= 0)
+        return 0;
+
+    cx0 = coll_floor_div(rect->x, grid->cell_size);
+    cy0 = coll_floor_div(rect->y, grid->cell_size);
+    cx1 = coll_floor_div(rect->x + rect->w - 1, grid->cell_size);
+    cy1 = coll_floor_div(rect->y + rect->h - 1, grid->cell_size);
+
+    if (coll_grow((void**)&grid->items, &grid->item_capacity,
+            grid->item_count + 1, sizeof(coll_item_t)))
+        return -2;
+    if (coll_grow((void**)&grid->cells, &grid->cell_capacity,
+            grid->cell_count + (cx1 - cx0 + 1) * (cy1 - cy0 + 1), sizeof(coll_cell_t)))
+        return -2;
+
+    item = grid->item_count++;
+    grid->items[item].rect = *rect;
+    grid->items[item].id = id;
+    grid->items[item].stamp = grid->stamp;
+
+    for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            bucket = coll_hash(grid, cx, cy);
+            cell = &(grid->cells[grid->cell_count]);
+            cell->cx = cx;
+            cell->cy = cy;
+            cell->item = item;
+            cell->next = grid->buckets[bucket];
+            grid->buckets[bucket] = grid->cell_count++;
+        }
+    }
+    return 0;
+}
+
+int coll_grid_query(coll_grid_t* grid, const frame_rect_t* rect, int* ids, int max_ids)
+{
+    int found;
+    int cx0, cy0, cx1, cy1;
+    coll_cell_t* cell;
+    coll_item_t* item;
+
+    if (!grid || !rect)
+        return -1;
+    if (rect->w <= 0 || rect->h <= 0)
+        return 0;
+
+    cx0 = coll_floor_div(rect->x, grid->cell_size);
+    cy0 = coll_floor_div(rect->y, grid->cell_size);
+    cx1 = coll_floor_div(rect->x + rect->w - 1, grid->cell_size);
+    cy1 = coll_floor_div(rect->y + rect->h - 1, grid->cell_size);
+
+    // items spanning several cells are reported on their first hit only
+    grid->stamp++;
+    found = 0;
+    for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            int i = grid->buckets[coll_hash(grid, cx, cy)];
+            for (; i >= 0; i = cell->next) {
+                cell = &(grid->cells[i]);
+                if (cell->cx != cx || cell->cy != cy)
+                    continue;
+
+                item = &(grid->items[cell->item]);
+                if (item->stamp == grid->stamp)
+                    continue;
+                item->stamp = grid->stamp;
+                if (!coll_overlap(&item->rect, rect))
+                    continue;
+
+                if (ids && found < max_ids)
+                    ids[found] = item->id;
+                found++;
+            }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,59 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2025 SmithGoll
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _COLL_GRID_H_
+#define _COLL_GRID_H_
+
+#include "sprite.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// structs
+
+// uniform grid broadphase: rects are hashed into every cell they touch,
+// a query only looks at the cells its own rect touches
+struct coll_grid_s;
+typedef struct coll_grid_s coll_grid_t;
+
+// public functions
+
+// cell_size should be around the size of a typical rect
+coll_grid_t* coll_grid_new   (int cell_size, int bucket_count);
+void         coll_grid_free  (coll_grid_t *grid);
+
+// forget every rect, call once per tick before inserting again
+void         coll_grid_clear (coll_grid_t *grid);
+int          coll_grid_insert(coll_grid_t *grid, int id, const frame_rect_t *rect);
+
+// ids of the inserted rects overlapping rect, each reported once;
+// returns how many overlap, only the first max_ids are written
+int          coll_grid_query (coll_grid_t *grid, const frame_rect_t *rect, int *ids, int max_ids);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
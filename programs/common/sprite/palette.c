@@ -24,31 +24,179 @@
 
 #include "palette.h"
 
-// #define USE_PIXELFORMAT_RGBA8888
+#include <string.h> /* memcpy, memset */
 
-#ifdef USE_PIXELFORMAT_RGBA8888
-#define INVERT_RB
+#include "engine_tex_impl.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PALETTE_HAVE_SSE2
+#include <emmintrin.h>
 #endif
 
-#ifdef INVERT_RB
-static inline void swap_impl(uint8_t* a, uint8_t* b)
+// every palette starts on this boundary inside the shared block
+#define PALETTE_ALIGN 16
+
+// private functions
+
+// one color to ARGB 8888, transparent entries become 0
+static inline uint32_t convert_4444(uint32_t c)
 {
-    uint8_t tmp = *a;
-    *a = *b;
-    *b = tmp;
-    return;
+    uint32_t t = (c & 0xF000) << 12 | (c & 0x0F00) << 8 | (c & 0x00F0) << 4 | (c & 0x000F);
+    return t | t << 4;
+}
+
+static inline uint32_t convert_1555(uint32_t c)
+{
+    if (!(c & 0x8000))
+        return 0;
+    return 0xFF000000 | (c & 0x7C00) << 9 | (c & 0x3E0) << 6 | (c & 0x1F) << 3;
+}
+
+static inline uint32_t convert_0565(uint32_t c)
+{
+    if (c == 0xF81F)
+        return 0;
+    return 0xFF000000 | (c & 0xF800) << 8 | (c & 0x7E0) << 5 | (c & 0x1F) << 3;
+}
+
+// every 0332 byte as ARGB, 0xC0 is the transparent one
+#define C332(c)     ((c) == 0xC0 ? 0 : 0xFF000000u | ((c) & 0xE0u) << 16 | ((c) & 0x1Cu) << 11 | ((c) & 0x03u) << 6)
+#define C332_4(c)   C332(c), C332((c) + 1), C332((c) + 2), C332((c) + 3)
+#define C332_16(c)  C332_4(c), C332_4((c) + 4), C332_4((c) + 8), C332_4((c) + 12)
+#define C332_64(c)  C332_16(c), C332_16((c) + 16), C332_16((c) + 32), C332_16((c) + 48)
+
+static const uint32_t lut_0332[256] = {
+    C332_64(0), C332_64(64), C332_64(128), C332_64(192)
+};
+
+#ifdef PALETTE_HAVE_SSE2
+// 4 zero extended 16-bit colors to ARGB, same math as the scalar converters
+static inline __m128i convert4_sse2(__m128i c, uint16_t pixel_format)
+{
+    __m128i t;
+
+    switch (pixel_format) {
+    case PIXEL_FORMAT_4444:
+        t = _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0xF000)), 12),
+                _mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0x0F00)), 8)),
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0x00F0)), 4),
+                _mm_and_si128(c, _mm_set1_epi32(0x000F))));
+        return _mm_or_si128(t, _mm_slli_epi32(t, 4));
+    case PIXEL_FORMAT_1555:
+        t = _mm_or_si128(
+            _mm_or_si128(_mm_set1_epi32((int)0xFF000000), _mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0x7C00)), 9)),
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0x3E0)), 6),
+                _mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0x1F)), 3)));
+        // bit 15 spread over the lane keeps or drops the color
+        return _mm_and_si128(t, _mm_srai_epi32(_mm_slli_epi32(c, 16), 31));
+    default: // PIXEL_FORMAT_0565
+        t = _mm_or_si128(
+            _mm_or_si128(_mm_set1_epi32((int)0xFF000000), _mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0xF800)), 8)),
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0x7E0)), 5),
+                _mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(0x1F)), 3)));
+        return _mm_andnot_si128(_mm_cmpeq_epi32(c, _mm_set1_epi32(0xF81F)), t);
+    }
 }
 #endif
 
-static inline void bytes_copy(const uint8_t* src, size_t offset, void* dest, size_t size)
+// count little endian colors of pixel_format to ARGB
+static void palette_convert(const uint8_t* src, uint16_t pixel_format, int count, uint32_t* out)
 {
-    uint8_t* dst = (uint8_t*)dest;
-    for (int i = 0; i < size; i++) {
-        dst[i] = src[i + offset];
+    int i = 0;
+
+    if (pixel_format == PIXEL_FORMAT_8888) {
+#ifdef PALETTE_HAVE_SSE2
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            _mm_storeu_si128((__m128i*)(out + i), v);
+        }
+#endif
+        for (; i < count; i++) {
+            const uint8_t* b = src + i * 4;
+            out[i] = (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+        }
+        return;
+    }
+
+    // no alpha in 0888, B G R in that order like the 8888 bytes
+    if (pixel_format == PIXEL_FORMAT_0888) {
+        for (; i < count; i++) {
+            const uint8_t* b = src + i * 3;
+            out[i] = 0xFF000000 | (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16;
+        }
+        return;
+    }
+
+    if (pixel_format == PIXEL_FORMAT_0332) {
+        for (; i < count; i++) {
+            out[i] = lut_0332[src[i]];
+        }
+        return;
+    }
+
+#ifdef PALETTE_HAVE_SSE2
+    for (; i + 8 <= count; i += 8) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 2));
+
+        _mm_storeu_si128((__m128i*)(out + i), convert4_sse2(_mm_unpacklo_epi16(v, zero), pixel_format));
+        _mm_storeu_si128((__m128i*)(out + i + 4), convert4_sse2(_mm_unpackhi_epi16(v, zero), pixel_format));
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t c = (uint32_t)src[i * 2] | (uint32_t)src[i * 2 + 1] << 8;
+
+        switch (pixel_format) {
+        case PIXEL_FORMAT_4444:
+            out[i] = convert_4444(c);
+            break;
+        case PIXEL_FORMAT_1555:
+            out[i] = convert_1555(c);
+            break;
+        default:
+            out[i] = convert_0565(c);
+            break;
+        }
     }
     return;
 }
 
+// palettes_t, then the palette_t table, then the aligned colors, which are
+// left as they are. texel_data points at them
+static palettes_t* palettes_alloc(int total_palette, int total_pixels)
+{
+    int stride;
+    size_t head_size;
+    size_t pad;
+    uint8_t* p;
+    uint32_t* pixels;
+    palettes_t* res;
+
+    stride = (total_pixels + PALETTE_ALIGN / 4 - 1) & ~(PALETTE_ALIGN / 4 - 1);
+    head_size = sizeof(palettes_t) + total_palette * sizeof(palette_t);
+    p = (uint8_t*)malloc(head_size + PALETTE_ALIGN - 1 + (size_t)total_palette * stride * sizeof(uint32_t));
+    if (!p)
+        return NULL;
+
+    pad = (PALETTE_ALIGN - ((uintptr_t)(p + head_size) & (PALETTE_ALIGN - 1))) & (PALETTE_ALIGN - 1);
+    pixels = (uint32_t*)(p + head_size + pad);
+    res = (palettes_t*)p;
+    res->total_palettes = total_palette;
+    res->palettes = (palette_t*)(res + 1);
+    res->texel_block = NULL;
+    for (int i = 0; i < total_palette; i++) {
+        palette_t* pal = &(res->palettes[i]);
+
+        pal->total_pixels = total_pixels;
+        pal->pixel_data = pixels + i * stride;
+        pal->texel_format = TEX_FORMAT_ARGB8888;
+        pal->texel_data = pal->pixel_data;
+    }
+    return res;
+}
+
+// public functions
 int palette_get_count(const palettes_t* palettes)
 {
     if (!palettes)
@@ -83,133 +231,182 @@ void palettes_free(palettes_t* palettes)
     if (!palettes)
         return;
 
-    int total_palette = palette_get_count(palettes);
-    if (total_palette > 0) {
-        palette_t* palettes_tmp = palettes->palettes;
-        for (int i = 0; i < total_palette; i++) {
-            if (palettes_tmp[i].pixel_data) {
-                free(palettes_tmp[i].pixel_data);
-            }
-        }
-        free(palettes_tmp);
-    }
+    // header, palette table and colors share one block
+    if (palettes->texel_block)
+        free(palettes->texel_block);
     free(palettes);
     return;
 }
 
 palettes_t* palettes_load(const uint8_t* data, uint16_t pixel_format, int total_palette, int total_pixels)
 {
+    int src_size;
     palettes_t* res;
-    palette_t* palettes_tmp;
 
-    int cur_pos;
+    if (!data || total_palette <= 0 || total_pixels <= 0)
+        return NULL;
+    src_size = palette_get_format_size(pixel_format);
+    if (!src_size)
+        return NULL;
 
-    if (total_palette <= 0 || total_pixels <= 0)
+    res = palettes_alloc(total_palette, total_pixels);
+    if (!res)
         return NULL;
-    if (!palette_get_format_size(pixel_format))
+    for (int i = 0; i < total_palette; i++) {
+        palette_convert(data + (size_t)i * total_pixels * src_size, pixel_format, total_pixels, res->palettes[i].pixel_data);
+    }
+    return res;
+}
+
+palettes_t* palettes_append(palettes_t* palettes, const uint32_t* colors, int count)
+{
+    int total_pixels;
+    int tex_format;
+    palettes_t* res;
+
+    if (!palettes || !colors || count < 0)
         return NULL;
 
-    res = (palettes_t*)malloc(sizeof(palettes_t));
-    palettes_tmp = (palette_t*)calloc(total_palette, sizeof(palette_t));
-    if (!res || !palettes_tmp) {
-        if (res) free(res);
-        if (palettes_tmp) free(palettes_tmp);
+    total_pixels = palettes->palettes[0].total_pixels;
+    res = palettes_alloc(palettes->total_palettes + 1, total_pixels);
+    if (!res)
         return NULL;
+    for (int i = 0; i < palettes->total_palettes; i++) {
+        memcpy(res->palettes[i].pixel_data, palettes->palettes[i].pixel_data, total_pixels * sizeof(uint32_t));
     }
 
-    cur_pos = 0;
-    for (int i = 0; i < total_palette; i++) {
-        uint32_t* t = (uint32_t*)calloc(total_pixels, sizeof(uint32_t));
-        if (!t) {
-            cur_pos += palette_get_format_size(pixel_format) * total_pixels;
-            palettes_tmp[i].total_pixels = 0;
-            palettes_tmp[i].pixel_data = NULL;
-            continue;
-        }
+    // the sprite only indexes total_pixels colors, the rest of a longer
+    // table is dropped and a shorter one leaves them transparent
+    if (count > total_pixels)
+        count = total_pixels;
+    memcpy(res->palettes[palettes->total_palettes].pixel_data, colors, count * sizeof(uint32_t));
+    memset(res->palettes[palettes->total_palettes].pixel_data + count, 0, (total_pixels - count) * sizeof(uint32_t));
 
-        switch (pixel_format) {
-        case PIXEL_FORMAT_8888: {
-            for (int j = 0; j < total_pixels; j++) {
-                uint32_t c;
-                bytes_copy((const uint8_t*)data, cur_pos, (void*)&c,
-                    sizeof(c));
-                cur_pos += 4;
-                if ((c & 0xFF000000) != 0xFF000000) {
-                    // have_alpha = true;
-                }
-                t[j] = c;
-            }
-            break;
-        }
+    tex_format = palettes->palettes[0].texel_format;
+    if (palettes_set_texel_format(res, tex_format)) {
+        palettes_free(res);
+        return NULL;
+    }
+    palettes_free(palettes);
+    return res;
+}
 
-        case PIXEL_FORMAT_4444: {
-            for (int j = 0; j < total_pixels; j++) {
-                uint16_t c;
-                bytes_copy((const uint8_t*)data, cur_pos, (void*)&c,
-                    sizeof(c));
-                cur_pos += 2;
-                if ((c & 0xF000) != 0xF000) {
-                    // have_alpha = true;
-                }
-                t[j] = ((c & 0xF000) << 16 | // A
-                    (c & 0xF000) << 12 | // A
-                    (c & 0x0F00) << 12 | // R
-                    (c & 0x0F00) << 8 | // R
-                    (c & 0x00F0) << 8 | // G
-                    (c & 0x00F0) << 4 | // G
-                    (c & 0x000F) << 4 | // B
-                    (c & 0x000F)); // B
-            }
-            break;
-        }
+int palette_parse_act(const uint8_t* data, int data_len, uint32_t* colors)
+{
+    int count;
+    int key;
 
-        case PIXEL_FORMAT_1555: {
-            for (int j = 0; j < total_pixels; j++) {
-                uint16_t c;
-                bytes_copy((const uint8_t*)data, cur_pos, (void*)&c,
-                    sizeof(c));
-                cur_pos += 2;
-                unsigned int alpha = 0xFF000000;
-                if ((c & 0x8000) != 0x8000) {
-                    // alpha = 0;
-                    // have_alpha = true;
-                    t[j] = 0;
-                    continue;
-                }
-                t[j] = (alpha | (c & 0x7C00) << 9 | (c & 0x3E0) << 6 | (c & 0x1F) << 3);
-            }
-            break;
-        }
+    if (!data || !colors || data_len < PALETTE_ACT_SIZE)
+        return -1;
 
-        case PIXEL_FORMAT_0565: {
-            for (int j = 0; j < total_pixels; j++) {
-                uint16_t c;
-                bytes_copy((const uint8_t*)data, cur_pos, (void*)&c,
-                    sizeof(c));
-                cur_pos += 2;
-                unsigned int alpha = 0xFF000000;
-                if (c == 0xF81F) {
-                    // alpha = 0;
-                    // have_alpha = true;
-                    t[j] = 0;
-                    continue;
-                }
-                t[j] = (alpha | (c & 0xF800) << 8 | (c & 0x7E0) << 5 | (c & 0x1F) << 3);
-            }
-            break;
-        }
+    // the optional trailer holds the color count and transparent index
+    count = 256;
+    key = -1;
+    if (data_len >= PALETTE_ACT_EXT_SIZE) {
+        count = data[PALETTE_ACT_SIZE] << 8 | data[PALETTE_ACT_SIZE + 1];
+        key = data[PALETTE_ACT_SIZE + 2] << 8 | data[PALETTE_ACT_SIZE + 3];
+        if (!count || count > 256)
+            count = 256;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t* rgb = data + i * 3;
+        uint32_t color = 0xFF000000 | (uint32_t)rgb[0] << 16 | (uint32_t)rgb[1] << 8 | rgb[2];
+
+        // magenta is the transparent color of the sprite editor
+        colors[i] = (i == key || color == 0xFFFF00FF) ? 0 : color;
+    }
+    return count;
+}
+
+uint32_t palette_color_to_texel(uint32_t color, int tex_format)
+{
+    switch (tex_format) {
+    case TEX_FORMAT_ABGR8888:
+        return (color & 0xFF00FF00) | (color >> 16 & 0xFF) | (color & 0xFF) << 16;
+    case TEX_FORMAT_ARGB4444:
+        return (color & 0xFF000000) | (color >> 16 & 0xF000) | (color >> 12 & 0x0F00)
+            | (color >> 8 & 0x00F0) | (color >> 4 & 0x000F);
+    case TEX_FORMAT_ARGB1555:
+        if (color >> 24 < 0x80)
+            return color & 0xFF000000;
+        return (color & 0xFF000000) | 0x8000 | (color >> 9 & 0x7C00) | (color >> 6 & 0x03E0) | (color >> 3 & 0x001F);
+    }
+    return color;
+}
+
+int palettes_set_texel_format(palettes_t* palettes, int tex_format)
+{
+    int stride;
+    uint32_t* block;
+
+    if (!palettes)
+        return -1;
+    if (palettes->palettes[0].texel_format == tex_format)
+        return 0;
+
+    block = NULL;
+    stride = palettes->palettes[0].total_pixels;
+    if (tex_format != TEX_FORMAT_ARGB8888) {
+        block = (uint32_t*)malloc((size_t)palettes->total_palettes * stride * sizeof(uint32_t));
+        if (!block)
+            return -2;
+    }
+
+    for (int i = 0; i < palettes->total_palettes; i++) {
+        palette_t* pal = &(palettes->palettes[i]);
+
+        pal->texel_format = tex_format;
+        if (!block) {
+            pal->texel_data = pal->pixel_data;
+            continue;
         }
-#ifdef INVERT_RB
-        for (int j = 0; j < total_pixels; j++) {
-            swap_impl((uint8_t*)&t[j], ((uint8_t*)&t[j]) + 2);
+        pal->texel_data = block + i * stride;
+        for (int j = 0; j < pal->total_pixels; j++) {
+            pal->texel_data[j] = palette_color_to_texel(pal->pixel_data[j], tex_format);
         }
-#endif
-        palettes_tmp[i].total_pixels = total_pixels;
-        palettes_tmp[i].pixel_data = t;
     }
-    res->total_palettes = total_palette;
-    res->palettes = palettes_tmp;
-    return res;
+    if (palettes->texel_block)
+        free(palettes->texel_block);
+    palettes->texel_block = block;
+    return 0;
+}
+
+int palette_set_colors(palette_t* palette, int first, int count, const uint32_t* colors)
+{
+    if (!palette || !colors || first < 0 || count <= 0 || count > palette->total_pixels - first)
+        return -1;
+
+    for (int i = 0; i < count; i++) {
+        palette->pixel_data[first + i] = colors[i];
+    }
+    if (palette->texel_data == palette->pixel_data)
+        return 0;
+    for (int i = first; i < first + count; i++) {
+        palette->texel_data[i] = palette_color_to_texel(palette->pixel_data[i], palette->texel_format);
+    }
+    return 0;
+}
+
+int palette_rotate(palette_t* palette, int first, int count, int step)
+{
+    uint32_t colors[256];
+
+    if (!palette || first < 0 || count <= 0 || count > palette->total_pixels - first)
+        return -1;
+    if (count > 256)
+        return -1;
+
+    step %= count;
+    if (step < 0)
+        step += count;
+    if (!step)
+        return 0;
+
+    for (int i = 0; i < count; i++) {
+        colors[(i + step) % count] = palette->pixel_data[first + i];
+    }
+    return palette_set_colors(palette, first, count, colors);
 }
 
 int palette_get_format_size(uint16_t pixel_format)
@@ -217,10 +414,14 @@ int palette_get_format_size(uint16_t pixel_format)
     switch (pixel_format) {
     case PIXEL_FORMAT_8888:
         return 4;
+    case PIXEL_FORMAT_0888:
+        return 3;
     case PIXEL_FORMAT_4444:
     case PIXEL_FORMAT_1555:
     case PIXEL_FORMAT_0565:
         return 2;
+    case PIXEL_FORMAT_0332:
+        return 1;
     }
     return 0;
 }
@@ -37,18 +37,31 @@ extern "C" {
 #define PIXEL_FORMAT_4444 0x4444
 #define PIXEL_FORMAT_1555 0x5515
 #define PIXEL_FORMAT_0565 0x6505
+#define PIXEL_FORMAT_0888 0x8808
+#define PIXEL_FORMAT_0332 0x3203
+
+// Adobe color table: 256 RGB triplets, the longer form adds a big endian
+// color count and transparent index
+#define PALETTE_ACT_SIZE     768
+#define PALETTE_ACT_EXT_SIZE 772
 
 // structs
 typedef struct palette_s
 {
     int total_pixels;
-    uint32_t *pixel_data;
+    uint32_t *pixel_data; // ARGB 8888
+
+    // pixel_data in the TEX_FORMAT_* the sprite uploads, pixel_data itself
+    // for ARGB 8888. 16-bit texels sit in the low half, the top byte keeps alpha
+    int texel_format;
+    uint32_t *texel_data;
 } palette_t;
 
 typedef struct palettes_s
 {
     int total_palettes;
     palette_t *palettes;
+    uint32_t *texel_block; // texel_data of every palette, NULL for ARGB 8888
 } palettes_t;
 
 // public functions
@@ -69,6 +82,24 @@ palettes_t* palettes_load       (const uint8_t *data,
 
 int palette_get_format_size(uint16_t pixel_format);
 
+// a copy of palettes with count ARGB colors added as the last palette, the
+// old palettes are freed. NULL on failure, palettes stays valid then
+palettes_t* palettes_append     (palettes_t *palettes, const uint32_t *colors, int count);
+
+// .act data to at most 256 ARGB colors, returns their count or -1
+int         palette_parse_act   (const uint8_t *data, int data_len, uint32_t *colors);
+
+// ARGB color as a texel of tex_format, see palette_t
+uint32_t    palette_color_to_texel(uint32_t color, int tex_format);
+// fills texel_data of every palette, 0 on success
+int         palettes_set_texel_format(palettes_t *palettes, int tex_format);
+
+// palette animation, both keep texel_data in step. 0 on success
+// colors [first, first + count) become the count ARGB colors
+int         palette_set_colors  (palette_t *palette, int first, int count, const uint32_t *colors);
+// colors [first, first + count) move step entries up, down when negative
+int         palette_rotate      (palette_t *palette, int first, int count, int step);
+
 #ifdef __cplusplus
 }
 #endif
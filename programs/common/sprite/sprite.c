@@ -27,9 +27,11 @@
 #include <stdio.h> /* fprintf */
 #include <string.h> /* memset */
 
+#include "bsprite.h"
 #include "engine_tex_impl.h"
 #include "palette.h"
 #include "texture.h"
+#include "thread_impl.h"
 
 #define FAIL_STRING() ("Failed at %s in %s[%d]\n")
 #define FAIL_STRING_EX(fmt) ("Failed at %s(returned " fmt ") in %s[%d]\n")
@@ -50,14 +52,101 @@ typedef struct info_s {
     int data_offset;
 } info_t;
 
+// background palette switch, see sprite_change_palette_async
+enum {
+    ASYNC_PENDING,
+    ASYNC_READY,
+    ASYNC_UPLOADED
+};
+
+typedef struct async_s {
+    sprite_t* spr;
+    int pal_index;
+
+    // work list, touched by the workers under lock
+    int todo_count;
+    int* todo;
+    uint32_t** pixels;
+    texture_info_t* info; // class and uploaded rect of pixels
+    uint8_t* state;
+    int next;
+    int cancel;
+    mutex_t* lock;
+
+    // render thread only
+    int uploaded;
+    int thread_count;
+    thread_t** threads;
+} async_t;
+
+// SPRITE_LOAD_TRIM, the part of a module that was uploaded, w is 0 until
+// the module is decoded
+typedef struct trim_s {
+    uint16_t x, y;
+    uint16_t w, h;
+} trim_t;
+
+// SPRITE_LOAD_FRAME_CACHE, one per (frame, palette, flip)
+typedef struct frame_cache_s {
+    void* module;
+    int x, y; // top left of module relative to the frame origin
+    int done; // module stays NULL for empty frames
+} frame_cache_t;
+
 typedef struct priv_data_s {
     info_t* infos;
+    // shapes by module, type 0 for images. NULL when all modules are images
+    tex_prim_t* prims;
     uint8_t* data;
     uint16_t encode_format;
+    int texel_format; // TEX_FORMAT_* of the modules, atlas pages pick their own
+    int load_flags;
+    async_t* async;
+
+    // SPRITE_LOAD_INDEXED only
+    uint8_t** indices;
+    int* index_pal;
+
+    // SPRITE_LOAD_FRAME_CACHE only
+    frame_cache_t* frame_cache;
+
+    // sprite_set_viewport
+    int has_viewport;
+    frame_rect_t viewport;
+
+    // SPRITE_LOAD_COLL_MASK only, module masks packed back to back
+    uint64_t* masks;
+    int* mask_offsets;
+
+    // TEX_ALPHA_* per (palette, module), laid out like modules
+    uint8_t* module_alpha;
+    // SPRITE_LOAD_TRIM only, same layout
+    trim_t* module_trim;
+
+    // TEXTURE_USAGE_WORDS per module, made by the first palette animation
+    uint64_t* index_usage;
+
+    // sprite_add_palette_act, palettes from lazy_palette on decode modules
+    // on first draw. palette_block holds the per palette arrays once they
+    // outgrew the sprite block
+    int lazy_palette;
+    void* palette_block;
 } priv_data_t;
 
+// a module mask placed in world space by sprite_frame_overlap
+typedef struct mask_place_s {
+    const uint64_t* mask;
+    int x, y, w, h;
+    int flip;
+} mask_place_t;
+
 // global variables
 
+// decodes of the calling thread, so a loader thread and the render thread
+// never share or free each other's buffer. the async workers keep their own
+// results
+static THREAD_LOCAL texture_scratch_t render_scratch;
+
 // private functions
 static void* ptr_offs(void* p, int offs)
 {
@@ -65,6 +154,696 @@ static void* ptr_offs(void* p, int offs)
     return (void*)(t + offs);
 }
 
+// the shape a module draws instead of image data, NULL for images
+static inline const tex_prim_t* sprite_module_prim(const sprite_t* spr, int module_index)
+{
+    const priv_data_t* private_data = (const priv_data_t*)spr->private_data;
+
+    if (!private_data->prims || !private_data->prims[module_index].type)
+        return NULL;
+    return &(private_data->prims[module_index]);
+}
+
+// pixels of a shape for the CPU side, rows pitch bytes apart
+static void sprite_prim_pixels(const tex_prim_t* prim, uint32_t* out, int pitch)
+{
+    for (int row = 0; row < prim->h; row++) {
+        tex_prim_row(prim, row, 0, prim->w, (uint32_t*)ptr_offs(out, row * pitch));
+    }
+    return;
+}
+
+static void sprite_set_trim(sprite_t* spr, int idx, const texture_info_t* rect)
+{
+    trim_t* t;
+
+    t = &(((priv_data_t*)spr->private_data)->module_trim[idx]);
+    t->x = (uint16_t)rect->x;
+    t->y = (uint16_t)rect->y;
+    t->w = (uint16_t)rect->w;
+    t->h = (uint16_t)rect->h;
+    return;
+}
+
+// NULL for TEX_ALPHA_EMPTY modules too, module_alpha tells them apart
+static void* sprite_decode_module(sprite_t* spr, int module_index, int pal_index, uint64_t* mask)
+{
+    int idx;
+    int trim;
+    void* module;
+    dim_t* dim;
+    info_t* info;
+    palette_t* pal;
+    texture_info_t result;
+    priv_data_t* private_data;
+
+    // shapes are drawn by the backend, they never get a module
+    if (sprite_module_prim(spr, module_index))
+        return NULL;
+
+    private_data = (priv_data_t*)spr->private_data;
+    pal = palette_get((palettes_t*)(spr->palettes), pal_index);
+    dim = &(spr->module_dims[module_index]);
+    info = &(private_data->infos[module_index]);
+    idx = module_index + pal_index * spr->module_count;
+    trim = private_data->module_trim != NULL;
+
+    module = texture_load(private_data->data + info->data_offset, info->data_len, private_data->encode_format,
+        pal, dim->w, dim->h, spr->tex_op, spr->user_data, mask, trim, &result, &render_scratch);
+    private_data->module_alpha[idx] = (uint8_t)result.alpha;
+    if (module && trim)
+        sprite_set_trim(spr, idx, &result);
+    return module;
+}
+
+// draws recorded in an open batch still show the current palette
+static inline int sprite_batch_active(const sprite_t* spr)
+{
+    return spr->tex_op->batch_active && spr->tex_op->batch_active(spr->user_data);
+}
+
+static inline int sprite_module_empty(const sprite_t* spr, int module_index, int pal_index)
+{
+    const priv_data_t* private_data = (const priv_data_t*)spr->private_data;
+
+    return private_data->module_alpha[module_index + pal_index * spr->module_count] == TEX_ALPHA_EMPTY;
+}
+
+// render thread only, valid until the next decode
+static uint32_t* sprite_decode_scratch(sprite_t* spr, int module_index, int pal_index)
+{
+    dim_t* dim;
+    info_t* info;
+    palette_t* pal;
+    uint32_t* pixels;
+    const tex_prim_t* prim;
+    priv_data_t* private_data;
+
+    prim = sprite_module_prim(spr, module_index);
+    if (prim) {
+        pixels = texture_scratch_get(&render_scratch, prim->w * prim->h);
+        if (pixels)
+            sprite_prim_pixels(prim, pixels, prim->w * sizeof(uint32_t));
+        return pixels;
+    }
+
+    private_data = (priv_data_t*)spr->private_data;
+    pal = palette_get((palettes_t*)(spr->palettes), pal_index);
+    dim = &(spr->module_dims[module_index]);
+    info = &(private_data->infos[module_index]);
+
+    return texture_decode_scratch(private_data->data + info->data_offset, info->data_len,
+        private_data->encode_format, pal, dim->w, dim->h, &render_scratch);
+}
+
+static uint32_t* sprite_decode_pixels(sprite_t* spr, int module_index, int pal_index)
+{
+    dim_t* dim;
+    info_t* info;
+    palette_t* pal;
+    uint32_t* pixels;
+    const tex_prim_t* prim;
+    priv_data_t* private_data;
+
+    prim = sprite_module_prim(spr, module_index);
+    if (prim) {
+        // same as texture_decode for an empty box
+        if (prim->w <= 0 || prim->h <= 0)
+            return NULL;
+        pixels = (uint32_t*)malloc(prim->w * prim->h * sizeof(uint32_t));
+        if (pixels)
+            sprite_prim_pixels(prim, pixels, prim->w * sizeof(uint32_t));
+        return pixels;
+    }
+
+    private_data = (priv_data_t*)spr->private_data;
+    pal = palette_get((palettes_t*)(spr->palettes), pal_index);
+    dim = &(spr->module_dims[module_index]);
+    info = &(private_data->infos[module_index]);
+
+    return texture_decode(private_data->data + info->data_offset, info->data_len,
+        private_data->encode_format, pal, dim->w, dim->h);
+}
+
+// worker safe, ARGB converted to the texels the modules are made of.
+// result gets the class and, trimmed or not, the rect pixels hold
+static uint32_t* sprite_decode_texels(sprite_t* spr, int module_index, int pal_index, texture_info_t* result)
+{
+    uint32_t* pixels;
+    dim_t* dim;
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    dim = &(spr->module_dims[module_index]);
+    result->x = 0;
+    result->y = 0;
+    result->w = dim->w;
+    result->h = dim->h;
+    pixels = sprite_decode_pixels(spr, module_index, pal_index);
+    result->alpha = texture_alpha_class(pixels, dim->w, dim->h);
+    if (!pixels || result->alpha == TEX_ALPHA_EMPTY)
+        return pixels;
+
+    if (private_data->module_trim && result->alpha != TEX_ALPHA_OPAQUE)
+        texture_trim(pixels, dim->w, dim->h, result);
+    texture_to_texels(pixels, result->w * result->h, private_data->texel_format);
+    return pixels;
+}
+
+// indexed mode keeps a single texture per module in modules[module_index]
+// and re-applies the palette from the decoded indices when it is stale
+static void* sprite_indexed_module(sprite_t* spr, int module_index, int pal_index)
+{
+    int count;
+    int alpha;
+    void* module;
+    dim_t* dim;
+    info_t* info;
+    uint32_t* pixels;
+    priv_data_t* private_data;
+
+    if (sprite_module_prim(spr, module_index))
+        return NULL;
+
+    private_data = (priv_data_t*)spr->private_data;
+    dim = &(spr->module_dims[module_index]);
+    if (!private_data->indices[module_index]) {
+        info = &(private_data->infos[module_index]);
+        private_data->indices[module_index] = texture_decode_indices(
+            private_data->data + info->data_offset, info->data_len,
+            private_data->encode_format, dim->w, dim->h);
+        if (!private_data->indices[module_index])
+            return NULL;
+    }
+
+    module = spr->modules[module_index];
+    if (module && private_data->index_pal[module_index] == pal_index)
+        return module;
+
+    count = dim->w * dim->h;
+    pixels = texture_scratch_get(&render_scratch, count);
+    if (!pixels)
+        return module;
+    alpha = texture_expand(private_data->indices[module_index], count,
+        palette_get((palettes_t*)(spr->palettes), pal_index), pixels);
+    private_data->module_alpha[module_index + pal_index * spr->module_count] = (uint8_t)alpha;
+    // the texture keeps its last palette, draws check module_alpha first
+    if (alpha == TEX_ALPHA_EMPTY)
+        return NULL;
+
+    if (module && spr->tex_op->module_update(module, pixels, spr->user_data)) {
+        spr->tex_op->module_free(module, spr->user_data);
+        module = NULL;
+    }
+    if (!module)
+        module = spr->tex_op->module_new(pixels, dim->w, dim->h, private_data->texel_format, spr->user_data);
+    if (module && spr->tex_op->module_alpha)
+        spr->tex_op->module_alpha(module, alpha, spr->user_data);
+
+    spr->modules[module_index] = module;
+    private_data->index_pal[module_index] = pal_index;
+    return module;
+}
+
+// straight alpha "over", matches SDL_BLENDMODE_BLEND drawing in sequence
+static inline uint32_t blend_over(uint32_t dst, uint32_t src)
+{
+    uint32_t sa, da, oa;
+    uint32_t res;
+
+    sa = src >> 24;
+    da = dst >> 24;
+    if (sa == 0xFF || !da)
+        return src;
+    if (!sa)
+        return dst;
+
+    // da' = da * (1 - sa), scaled by 255
+    da = da * (0xFF - sa);
+    oa = sa * 0xFF + da;
+    res = (oa / 0xFF) << 24;
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t sc = (src >> shift) & 0xFF;
+        uint32_t dc = (dst >> shift) & 0xFF;
+        res |= ((sc * sa * 0xFF + dc * da + oa / 2) / oa) << shift;
+    }
+    return res;
+}
+
+static void blend_module(uint32_t* dst, int dst_w, const uint32_t* src, int w, int h, int x, int y, int flip)
+{
+    for (int row = 0; row < h; row++) {
+        int sy = (flip & FLIP_Y) ? h - 1 - row : row;
+        const uint32_t* s = src + sy * w;
+        uint32_t* d = dst + (y + row) * dst_w + x;
+
+        for (int col = 0; col < w; col++) {
+            int sx = (flip & FLIP_X) ? w - 1 - col : col;
+            d[col] = blend_over(d[col], s[sx]);
+        }
+    }
+    return;
+}
+
+// render every fmodule of a frame once on the CPU, the result is drawn
+// with a single module_paint afterwards
+static frame_cache_t* sprite_frame_cache_get(sprite_t* spr, int frame_index, int flip)
+{
+    int count;
+    int alpha;
+    int offset;
+    int min_x, min_y, max_x, max_y;
+    int cache_w, cache_h;
+    uint32_t* pixels;
+    frame_rect_t* bounds;
+    frame_cache_t* entry;
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    flip &= FLIP_XY;
+    entry = &(private_data->frame_cache[(spr->cur_palette * spr->frame_count + frame_index) * 4 + flip]);
+    if (entry->done)
+        return entry;
+
+    count = spr->frames[frame_index].count;
+    offset = spr->frames[frame_index].offset;
+    if (offset < 0 || offset + count > spr->fmodule_count)
+        return NULL;
+
+    for (int i = 0; i < count; i++) {
+        int module_index = spr->fmodules[i + offset].module_index;
+        if (module_index < 0 || module_index >= spr->module_count)
+            return NULL;
+    }
+
+    bounds = &(spr->frame_bounds[frame_index * 4 + flip]);
+    min_x = bounds->x;
+    min_y = bounds->y;
+    max_x = bounds->x + bounds->w;
+    max_y = bounds->y + bounds->h;
+
+    entry->done = 1;
+    entry->module = NULL;
+    if (!count || max_x <= min_x || max_y <= min_y)
+        return entry;
+
+    cache_w = max_x - min_x;
+    cache_h = max_y - min_y;
+    pixels = (uint32_t*)calloc(cache_w * cache_h, sizeof(uint32_t));
+    if (!pixels) {
+        entry->done = 0;
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        fmodule_t* fm = &(spr->fmodules[i + offset]);
+        int off_x, off_y, w, h;
+        uint32_t* src;
+
+        w = spr->module_dims[fm->module_index].w;
+        h = spr->module_dims[fm->module_index].h;
+        off_x = (flip & FLIP_X) ? -fm->x - w : fm->x;
+        off_y = (flip & FLIP_Y) ? -fm->y - h : fm->y;
+        if (sprite_module_empty(spr, fm->module_index, spr->cur_palette))
+            continue;
+        src = sprite_decode_scratch(spr, fm->module_index, spr->cur_palette);
+        if (!src)
+            continue;
+        blend_module(pixels, cache_w, src, w, h, off_x - min_x, off_y - min_y,
+            flip ^ fm->flip);
+    }
+
+    // fully transparent frames stay without a module like empty ones
+    alpha = texture_alpha_class(pixels, cache_w, cache_h);
+    if (alpha == TEX_ALPHA_EMPTY) {
+        free(pixels);
+        return entry;
+    }
+    if (private_data->module_trim && alpha != TEX_ALPHA_OPAQUE) {
+        texture_info_t rect;
+
+        texture_trim(pixels, cache_w, cache_h, &rect);
+        min_x += rect.x;
+        min_y += rect.y;
+        cache_w = rect.w;
+        cache_h = rect.h;
+        alpha = texture_alpha_class(pixels, cache_w, cache_h);
+    }
+
+    texture_to_texels(pixels, cache_w * cache_h, private_data->texel_format);
+    entry->module = spr->tex_op->module_new(pixels, cache_w, cache_h, private_data->texel_format, spr->user_data);
+    entry->x = min_x;
+    entry->y = min_y;
+    free(pixels);
+    if (!entry->module) {
+        entry->done = 0;
+        return NULL;
+    }
+    if (spr->tex_op->module_alpha)
+        spr->tex_op->module_alpha(entry->module, alpha, spr->user_data);
+    return entry;
+}
+
+static void sprite_free_frame_cache(sprite_t* spr, int pal_index)
+{
+    int count;
+    frame_cache_t* entries;
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    if (!private_data || !private_data->frame_cache)
+        return;
+
+    count = spr->frame_count * 4;
+    entries = &(private_data->frame_cache[pal_index * count]);
+    for (int i = 0; i < count; i++) {
+        if (entries[i].module)
+            spr->tex_op->module_free(entries[i].module, spr->user_data);
+        entries[i].module = NULL;
+        entries[i].done = 0;
+    }
+    return;
+}
+
+// palette indices each module draws with, modules whose data cannot be
+// walked count as using all of them
+static int sprite_build_index_usage(sprite_t* spr)
+{
+    uint64_t* usage;
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->index_usage)
+        return 0;
+
+    usage = (uint64_t*)malloc(spr->module_count * TEXTURE_USAGE_WORDS * sizeof(uint64_t));
+    if (!usage)
+        return -1;
+    for (int i = 0; i < spr->module_count; i++) {
+        info_t* info = &(private_data->infos[i]);
+        uint64_t* used = usage + i * TEXTURE_USAGE_WORDS;
+
+        // shapes carry their own color
+        if (sprite_module_prim(spr, i)) {
+            memset(used, 0, TEXTURE_USAGE_WORDS * sizeof(uint64_t));
+            continue;
+        }
+        if (texture_index_usage(private_data->data + info->data_offset, info->data_len, private_data->encode_format,
+                spr->module_dims[i].w, spr->module_dims[i].h, used))
+            memset(used, 0xFF, TEXTURE_USAGE_WORDS * sizeof(uint64_t));
+    }
+    private_data->index_usage = usage;
+    return 0;
+}
+
+static inline int sprite_module_uses(const priv_data_t* private_data, int module_index, const uint64_t* colors)
+{
+    const uint64_t* used = private_data->index_usage + module_index * TEXTURE_USAGE_WORDS;
+
+    for (int i = 0; i < TEXTURE_USAGE_WORDS; i++) {
+        if (used[i] & colors[i])
+            return 1;
+    }
+    return 0;
+}
+
+// the module of (module_index, pal_index) no longer matches its palette
+static void sprite_refresh_module(sprite_t* spr, int module_index, int pal_index)
+{
+    int idx;
+    void* module;
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    idx = module_index + pal_index * spr->module_count;
+    private_data->module_alpha[idx] = TEX_ALPHA_UNKNOWN;
+
+    // indexed modules re-apply the palette from their indices on next use
+    if (private_data->load_flags & SPRITE_LOAD_INDEXED) {
+        if (private_data->index_pal[module_index] == pal_index)
+            private_data->index_pal[module_index] = -1;
+        return;
+    }
+
+    // the alpha class and the trim rect may change with the colors, so the
+    // module is made again. modules never made stay so
+    module = spr->modules[idx];
+    if (!module)
+        return;
+    spr->tex_op->module_free(module, spr->user_data);
+    spr->modules[idx] = NULL;
+    if (private_data->module_trim)
+        private_data->module_trim[idx].w = 0;
+    if (!(private_data->load_flags & SPRITE_LOAD_LAZY))
+        spr->modules[idx] = sprite_decode_module(spr, module_index, pal_index, NULL);
+    return;
+}
+
+// colors [first, first + count) of pal_index changed, only what draws one
+// of them is brought up to date
+static void sprite_palette_changed(sprite_t* spr, int pal_index, int first, int count)
+{
+    uint64_t colors[TEXTURE_USAGE_WORDS];
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    memset(colors, 0, sizeof(colors));
+    for (int i = first; i < first + count && i < TEXTURE_USAGE_WORDS * 64; i++) {
+        colors[i >> 6] |= (uint64_t)1 << (i & 63);
+    }
+
+    for (int i = 0; i < spr->module_count; i++) {
+        if (sprite_module_uses(private_data, i, colors))
+            sprite_refresh_module(spr, i, pal_index);
+    }
+
+    if (!private_data->frame_cache)
+        return;
+    for (int f = 0; f < spr->frame_count; f++) {
+        frame_t* frame = &(spr->frames[f]);
+        frame_cache_t* entries = &(private_data->frame_cache[(pal_index * spr->frame_count + f) * 4]);
+        int hit = 0;
+
+        // sprite_frame_cache_get only fills entries of valid frames
+        if (frame->offset < 0 || frame->offset + frame->count > spr->fmodule_count)
+            continue;
+        for (int i = 0; i < frame->count && !hit; i++) {
+            int module_index = spr->fmodules[frame->offset + i].module_index;
+
+            hit = module_index >= 0 && module_index < spr->module_count
+                && sprite_module_uses(private_data, module_index, colors);
+        }
+        if (!hit)
+            continue;
+        for (int flip = 0; flip < 4; flip++) {
+            if (entries[flip].module)
+                spr->tex_op->module_free(entries[flip].module, spr->user_data);
+            entries[flip].module = NULL;
+            entries[flip].done = 0;
+        }
+    }
+    return;
+}
+
+// the arrays laid out by palette, moved to a block for palette_count palettes
+static int sprite_grow_palettes(sprite_t* spr, int palette_count)
+{
+    int cache_count;
+    int count;
+    int old_count;
+    size_t needed_size;
+    uint8_t* p;
+    uint8_t* block;
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    count = spr->module_count * palette_count;
+    old_count = spr->module_count * spr->palette_count;
+    cache_count = private_data->frame_cache ? spr->frame_count * 4 : 0;
+
+    // pointers first to keep them aligned
+    needed_size = count * sizeof(void*);
+    needed_size += cache_count * palette_count * sizeof(frame_cache_t);
+    if (private_data->module_trim)
+        needed_size += count * sizeof(trim_t);
+    needed_size += count;
+    block = (uint8_t*)calloc(1, needed_size);
+    if (!block)
+        return -1;
+
+    p = block;
+    memcpy(p, spr->modules, old_count * sizeof(void*));
+    spr->modules = (void**)p;
+    p += count * sizeof(void*);
+    if (cache_count) {
+        memcpy(p, private_data->frame_cache, cache_count * spr->palette_count * sizeof(frame_cache_t));
+        private_data->frame_cache = (frame_cache_t*)p;
+        p += cache_count * palette_count * sizeof(frame_cache_t);
+    }
+    if (private_data->module_trim) {
+        memcpy(p, private_data->module_trim, old_count * sizeof(trim_t));
+        private_data->module_trim = (trim_t*)p;
+        p += count * sizeof(trim_t);
+    }
+    memcpy(p, private_data->module_alpha, old_count);
+    private_data->module_alpha = p;
+
+    if (private_data->palette_block)
+        free(private_data->palette_block);
+    private_data->palette_block = block;
+    return 0;
+}
+
+static void sprite_set_cur_palette(sprite_t* spr, int pal_index)
+{
+    // composed frames of the palette being left are dropped
+    if (spr->cur_palette != pal_index)
+        sprite_free_frame_cache(spr, spr->cur_palette);
+    spr->cur_palette = pal_index;
+    return;
+}
+
+static int sprite_async_worker(void* arg)
+{
+    int slot;
+    texture_info_t result;
+    uint32_t* pixels;
+    async_t* job;
+
+    job = (async_t*)arg;
+    while (1) {
+        mutex_lock(job->lock);
+        if (job->cancel || job->next >= job->todo_count) {
+            mutex_unlock(job->lock);
+            break;
+        }
+        slot = job->next++;
+        mutex_unlock(job->lock);
+
+        // decode failure is reported as a NULL buffer
+        pixels = sprite_decode_texels(job->spr, job->todo[slot], job->pal_index, &result);
+
+        mutex_lock(job->lock);
+        job->pixels[slot] = pixels;
+        job->info[slot] = result;
+        job->state[slot] = ASYNC_READY;
+        mutex_unlock(job->lock);
+    }
+    return 0;
+}
+
+static void sprite_async_free(async_t* job)
+{
+    if (!job)
+        return;
+
+    if (job->lock) {
+        mutex_lock(job->lock);
+        job->cancel = 1;
+        mutex_unlock(job->lock);
+    }
+    for (int i = 0; i < job->thread_count; i++) {
+        thread_join(job->threads[i]);
+    }
+    for (int i = 0; i < job->todo_count; i++) {
+        if (job->pixels[i])
+            free(job->pixels[i]);
+    }
+    mutex_free(job->lock);
+    free(job);
+    return;
+}
+
+static void sprite_async_cancel(sprite_t* spr)
+{
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    if (!private_data || !private_data->async)
+        return;
+
+    sprite_async_free(private_data->async);
+    private_data->async = NULL;
+    return;
+}
+
+// tight boxes of every frame and aframe for each flip, same placement
+// as sprite_draw_frame_module_impl. broken frames get an empty box
+static void sprite_compute_bounds(sprite_t* spr)
+{
+    int count;
+    int offset;
+    int min_x, min_y, max_x, max_y;
+    frame_rect_t* bounds;
+
+    for (int i = 0; i < spr->frame_count; i++) {
+        count = spr->frames[i].count;
+        offset = spr->frames[i].offset;
+        for (int flip = 0; flip < 4; flip++) {
+            bounds = &(spr->frame_bounds[i * 4 + flip]);
+            memset(bounds, 0, sizeof(frame_rect_t));
+            if (offset < 0 || offset + count > spr->fmodule_count)
+                continue;
+
+            min_x = min_y = 0x7FFFFFFF;
+            max_x = max_y = -0x7FFFFFFF;
+            for (int j = 0; j < count; j++) {
+                fmodule_t* fm = &(spr->fmodules[j + offset]);
+                int off_x, off_y, w, h;
+
+                if (fm->module_index < 0 || fm->module_index >= spr->module_count) {
+                    max_x = min_x;
+                    break;
+                }
+                w = spr->module_dims[fm->module_index].w;
+                h = spr->module_dims[fm->module_index].h;
+                off_x = (flip & FLIP_X) ? -fm->x - w : fm->x;
+                off_y = (flip & FLIP_Y) ? -fm->y - h : fm->y;
+                if (off_x < min_x) min_x = off_x;
+                if (off_y < min_y) min_y = off_y;
+                if (off_x + w > max_x) max_x = off_x + w;
+                if (off_y + h > max_y) max_y = off_y + h;
+            }
+            if (max_x <= min_x || max_y <= min_y)
+                continue;
+
+            bounds->x = min_x;
+            bounds->y = min_y;
+            bounds->w = max_x - min_x;
+            bounds->h = max_y - min_y;
+        }
+    }
+
+    for (int i = 0; i < spr->aframe_count; i++) {
+        aframe_t* af = &(spr->aframes[i]);
+        for (int flip = 0; flip < 4; flip++) {
+            bounds = &(spr->aframe_bounds[i * 4 + flip]);
+            memset(bounds, 0, sizeof(frame_rect_t));
+            if (af->frame_index < 0 || af->frame_index >= spr->frame_count)
+                continue;
+
+            *bounds = spr->frame_bounds[af->frame_index * 4 + ((flip ^ af->flip) & FLIP_XY)];
+            bounds->x += af->x;
+            bounds->y += af->y;
+        }
+    }
+    return;
+}
+
+// 1 when a w * h box at (x, y) misses the viewport
+static inline int sprite_culled(const priv_data_t* private_data, int x, int y, int w, int h)
+{
+    const frame_rect_t* view;
+
+    if (!private_data->has_viewport)
+        return 0;
+
+    view = &(private_data->viewport);
+    return w <= 0 || h <= 0
+        || x >= view->x + view->w || x + w <= view->x
+        || y >= view->y + view->h || y + h <= view->y;
+}
+
 static void sprite_draw_frame_module_impl(sprite_t* spr, int fm_index, int x, int y, int flip, int apply_flip)
 {
     int module_index;
@@ -98,187 +877,961 @@ static void sprite_draw_frame_module_impl(sprite_t* spr, int fm_index, int x, in
     return;
 }
 
-// public functions
-int sprite_get_abs_frame_vertex(sprite_t* spr, int frame_index, int flip, int* x, int* y)
+// masks follow palette 0, a module decoded here for the warmup emits
+// its mask on the way, the others are decoded once just for the mask
+static void sprite_build_masks(sprite_t* spr)
 {
-    int off_x, off_y;
-    int real_x, real_y;
-
-    frame_rect_t* frame_rect;
+    dim_t* dim;
+    uint32_t* pixels;
+    uint64_t* mask;
+    priv_data_t* private_data;
 
-    if (!spr || frame_index < 0)
-        return 1;
-    if (frame_index >= spr->frame_count)
-        return 2;
+    private_data = (priv_data_t*)spr->private_data;
+    for (int i = 0; i < spr->module_count; i++) {
+        dim = &(spr->module_dims[i]);
+        if (dim->w <= 0 || dim->h <= 0)
+            continue;
 
-    frame_rect = &(spr->frame_rects[frame_index]);
-    off_x = frame_rect->x;
-    off_y = frame_rect->y;
+        mask = private_data->masks + private_data->mask_offsets[i];
+        if (!(private_data->load_flags & (SPRITE_LOAD_LAZY | SPRITE_LOAD_INDEXED))) {
+            if (!spr->modules[i] && !sprite_module_empty(spr, i, 0))
+                spr->modules[i] = sprite_decode_module(spr, i, 0, mask);
+            // texture_load fills the mask of empty modules as well
+            if (spr->modules[i] || sprite_module_empty(spr, i, 0))
+                continue;
+        }
+
+        pixels = sprite_decode_scratch(spr, i, 0);
+        if (!pixels)
+            continue;
+        texture_pack_mask(pixels, dim->w, dim->h, mask);
+    }
+    return;
+}
+
+static inline uint64_t mask_reverse(uint64_t v)
+{
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+    v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+    return (v >> 32) | (v << 32);
+}
+
+// n (1..64) bits of a mask row from column start on, bit 0 is start
+static inline uint64_t mask_bits(const uint64_t* row, int words, int start, int n)
+{
+    int word;
+    int shift;
+    uint64_t v;
+
+    word = start >> 6;
+    shift = start & 63;
+    v = row[word] >> shift;
+    if (shift && word + 1 < words)
+        v |= row[word + 1] << (64 - shift);
+    if (n < 64)
+        v &= ((uint64_t)1 << n) - 1;
+    return v;
+}
+
+// n bits of the placed module from local (col, row) on, as drawn with its flip
+static inline uint64_t mask_place_bits(const mask_place_t* place, int row, int col, int n)
+{
+    int words;
+    const uint64_t* src;
+
+    words = TEXTURE_MASK_WORDS(place->w);
+    if (place->flip & FLIP_Y)
+        row = place->h - 1 - row;
+    src = place->mask + row * words;
+    if (place->flip & FLIP_X)
+        return mask_reverse(mask_bits(src, words, place->w - col - n, n)) >> (64 - n);
+    return mask_bits(src, words, col, n);
+}
+
+// same placement as sprite_draw_frame_module_impl
+static void sprite_mask_place(sprite_t* spr, int fm_index, int x, int y, int flip, mask_place_t* out)
+{
+    fmodule_t* fm;
+    priv_data_t* private_data;
+
+    private_data = (priv_data_t*)spr->private_data;
+    fm = &(spr->fmodules[fm_index]);
+    out->w = spr->module_dims[fm->module_index].w;
+    out->h = spr->module_dims[fm->module_index].h;
+    out->x = x + ((flip & FLIP_X) ? -fm->x - out->w : fm->x);
+    out->y = y + ((flip & FLIP_Y) ? -fm->y - out->h : fm->y);
+    out->flip = (flip ^ fm->flip) & FLIP_XY;
+    out->mask = private_data->masks + private_data->mask_offsets[fm->module_index];
+    return;
+}
+
+static int mask_place_overlap(const mask_place_t* a, const mask_place_t* b)
+{
+    int x0, y0, x1, y1;
+
+    x0 = a->x > b->x ? a->x : b->x;
+    y0 = a->y > b->y ? a->y : b->y;
+    x1 = a->x + a->w < b->x + b->w ? a->x + a->w : b->x + b->w;
+    y1 = a->y + a->h < b->y + b->h ? a->y + a->h : b->y + b->h;
+
+    // 64 columns per AND
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x += 64) {
+            int n = x1 - x < 64 ? x1 - x : 64;
+
+            if (mask_place_bits(a, y - a->y, x - a->x, n) & mask_place_bits(b, y - b->y, x - b->x, n))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// append size bytes of the file to the raw section buffer
+static int sprite_read_section(file_handle_t* handle, uint8_t** raw, int* raw_len, int size)
+{
+    uint8_t* t;
+
+    if (!size)
+        return 0;
+    t = (uint8_t*)realloc(*raw, *raw_len + size);
+    if (!t)
+        return -1;
+    *raw = t;
+    if (file_read(handle, t + *raw_len, size))
+        return -1;
+    *raw_len += size;
+    return 0;
+}
+
+// BS_MODULES records into raw, module_size apart like image records are.
+// shapes and markers differ in size, so from the first of them on records
+// are read one by one and those go to *prims, their slot in raw stays 0.
+// *prims is left NULL while all modules are images
+static int sprite_read_modules(file_handle_t* handle, const bs_layout_t* layout, int count,
+    uint8_t** raw, int* raw_len, tex_prim_t** prims)
+{
+    int size;
+    int first;
+    int rec_size;
+    size_t pos;
+    uint8_t* t;
+    uint8_t* slot;
+    uint8_t rec[BS_MODULE_MAX_SIZE];
+
+    size = count * layout->module_size;
+    if (!size)
+        return 0;
+    if (file_pos(handle, &pos))
+        return -1;
+    t = (uint8_t*)realloc(*raw, *raw_len + size);
+    if (!t)
+        return -1;
+    *raw = t;
+    slot = t + *raw_len;
+    *raw_len += size;
+
+    // one read for the usual file of images, the section of a file of small
+    // shapes may end before size bytes
+    first = 0;
+    if (!file_read(handle, slot, size)) {
+        while (first < count && bs_module_image(layout, slot[first * layout->module_size])) {
+            first++;
+        }
+        if (first == count)
+            return 0;
+    }
+
+    *prims = (tex_prim_t*)calloc(count, sizeof(tex_prim_t));
+    if (!*prims)
+        return -1;
+    memset(slot + first * layout->module_size, 0, (count - first) * layout->module_size);
+    if (file_seek(handle, (long)(pos + first * layout->module_size), FSEEK_SET))
+        return -1;
+    for (int i = first; i < count; i++) {
+        if (file_get_u8(handle, &rec[0]))
+            return -1;
+        rec_size = bs_module_size(layout, rec[0]);
+        if (!rec_size)
+            return -1;
+        if (rec_size > 1 && file_read(handle, rec + 1, rec_size - 1))
+            return -1;
+        if (!bs_read_prim(layout, rec, &((*prims)[i])))
+            memcpy(slot + i * layout->module_size, rec, rec_size);
+    }
+    return 0;
+}
+
+static int sprite_read_image_size(file_handle_t* handle, const bs_layout_t* layout, uint32_t* out)
+{
+    uint16_t u16t;
+
+    if (layout->image_size_len == 4)
+        return file_get_u32(handle, out);
+    if (file_get_u16(handle, &u16t))
+        return -1;
+    *out = u16t;
+    return 0;
+}
+
+// BS_MODULE_IMAGES_FX stores a flipped copy after each module, draws flip
+// on their own so it is skipped
+static int sprite_skip_image_fx(file_handle_t* handle, const bs_layout_t* layout)
+{
+    uint16_t u16t;
+
+    if (!(layout->flags & BS_MODULE_IMAGES_FX))
+        return 0;
+    if (file_get_u16(handle, &u16t))
+        return -1;
+    return u16t ? file_seek(handle, u16t, FSEEK_CUR) : 0;
+}
+
+// public functions
+void sprite_set_viewport(sprite_t* spr, int x, int y, int w, int h)
+{
+    priv_data_t* private_data;
+
+    if (!spr)
+        return;
+
+    private_data = (priv_data_t*)spr->private_data;
+    private_data->has_viewport = w > 0 && h > 0;
+    private_data->viewport.x = x;
+    private_data->viewport.y = y;
+    private_data->viewport.w = w;
+    private_data->viewport.h = h;
+    return;
+}
+
+int sprite_get_frame_bounds(sprite_t* spr, int frame_index, int flip, frame_rect_t* out)
+{
+    if (!spr || !out || frame_index < 0)
+        return -1;
+    if (frame_index >= spr->frame_count)
+        return -2;
+
+    *out = spr->frame_bounds[frame_index * 4 + (flip & FLIP_XY)];
+    return 0;
+}
+
+int sprite_get_aframe_bounds(sprite_t* spr, int af_index, int flip, frame_rect_t* out)
+{
+    if (!spr || !out || af_index < 0)
+        return -1;
+    if (af_index >= spr->aframe_count)
+        return -2;
+
+    *out = spr->aframe_bounds[af_index * 4 + (flip & FLIP_XY)];
+    return 0;
+}
+
+int sprite_get_frame_coll(sprite_t* spr, int frame_index, int x, int y, int flip, frame_rect_t* out)
+{
+    frame_rect_t* coll;
+
+    if (!spr || !out || frame_index < 0)
+        return -1;
+    if (frame_index >= spr->frame_count)
+        return -2;
+    if (!spr->frame_colls)
+        return -3;
+
+    // mirrored around the draw point like the fmodules
+    coll = &(spr->frame_colls[frame_index]);
+    out->x = (flip & FLIP_X) ? -coll->x - coll->w : coll->x;
+    out->y = (flip & FLIP_Y) ? -coll->y - coll->h : coll->y;
+    out->x += x;
+    out->y += y;
+    out->w = coll->w;
+    out->h = coll->h;
+    return 0;
+}
+
+int sprite_get_aframe_coll(sprite_t* spr, int af_index, int x, int y, int flip, frame_rect_t* out)
+{
+    aframe_t* af;
+
+    if (!spr || !out || af_index < 0)
+        return -1;
+    if (af_index >= spr->aframe_count)
+        return -2;
+
+    af = &(spr->aframes[af_index]);
+    return sprite_get_frame_coll(spr, af->frame_index, x + af->x, y + af->y, flip ^ af->flip, out);
+}
+
+const uint64_t* sprite_get_module_mask(sprite_t* spr, int module_index, int* words_per_row)
+{
+    priv_data_t* private_data;
+
+    if (!spr || module_index < 0 || module_index >= spr->module_count)
+        return NULL;
+
+    private_data = (priv_data_t*)spr->private_data;
+    if (!private_data->masks)
+        return NULL;
+
+    if (words_per_row)
+        *words_per_row = TEXTURE_MASK_WORDS(spr->module_dims[module_index].w);
+    return private_data->masks + private_data->mask_offsets[module_index];
+}
+
+int sprite_frame_overlap(sprite_t* spr_a, int frame_a, int xa, int ya, int flip_a,
+    sprite_t* spr_b, int frame_b, int xb, int yb, int flip_b)
+{
+    frame_t* fa;
+    frame_t* fb;
+    frame_rect_t ra, rb;
+    mask_place_t pa, pb;
+
+    if (!spr_a || !spr_b || frame_a < 0 || frame_b < 0)
+        return -1;
+    if (frame_a >= spr_a->frame_count || frame_b >= spr_b->frame_count)
+        return -2;
+    if (!((priv_data_t*)spr_a->private_data)->masks || !((priv_data_t*)spr_b->private_data)->masks)
+        return -3;
+
+    // boxes first, broken frames have an empty one
+    flip_a &= FLIP_XY;
+    flip_b &= FLIP_XY;
+    ra = spr_a->frame_bounds[frame_a * 4 + flip_a];
+    rb = spr_b->frame_bounds[frame_b * 4 + flip_b];
+    ra.x += xa;
+    ra.y += ya;
+    rb.x += xb;
+    rb.y += yb;
+    if (ra.w <= 0 || ra.h <= 0 || rb.w <= 0 || rb.h <= 0)
+        return 0;
+    if (ra.x >= rb.x + rb.w || rb.x >= ra.x + ra.w || ra.y >= rb.y + rb.h || rb.y >= ra.y + ra.h)
+        return 0;
+
+    fa = &(spr_a->frames[frame_a]);
+    fb = &(spr_b->frames[frame_b]);
+    for (int i = 0; i < fa->count; i++) {
+        sprite_mask_place(spr_a, fa->offset + i, xa, ya, flip_a, &pa);
+        if (pa.x >= rb.x + rb.w || rb.x >= pa.x + pa.w || pa.y >= rb.y + rb.h || rb.y >= pa.y + pa.h)
+            continue;
+
+        for (int j = 0; j < fb->count; j++) {
+            sprite_mask_place(spr_b, fb->offset + j, xb, yb, flip_b, &pb);
+            if (mask_place_overlap(&pa, &pb))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+int sprite_aframe_overlap(sprite_t* spr_a, int af_a, int xa, int ya, int flip_a,
+    sprite_t* spr_b, int af_b, int xb, int yb, int flip_b)
+{
+    aframe_t* a;
+    aframe_t* b;
+
+    if (!spr_a || !spr_b || af_a < 0 || af_b < 0)
+        return -1;
+    if (af_a >= spr_a->aframe_count || af_b >= spr_b->aframe_count)
+        return -2;
+
+    a = &(spr_a->aframes[af_a]);
+    b = &(spr_b->aframes[af_b]);
+    return sprite_frame_overlap(spr_a, a->frame_index, xa + a->x, ya + a->y, flip_a ^ a->flip,
+        spr_b, b->frame_index, xb + b->x, yb + b->y, flip_b ^ b->flip);
+}
+
+int sprite_get_abs_frame_vertex(sprite_t* spr, int frame_index, int flip, int* x, int* y)
+{
+    int off_x, off_y;
+    int real_x, real_y;
+
+    frame_rect_t* frame_rect;
+
+    if (!spr || frame_index < 0)
+        return 1;
+    if (frame_index >= spr->frame_count)
+        return 2;
+
+    frame_rect = &(spr->frame_rects[frame_index]);
+    off_x = frame_rect->x;
+    off_y = frame_rect->y;
 
     if (flip & FLIP_X)
         real_x = frame_rect->w + off_x;
     else real_x = 0;
 
-    if (flip & FLIP_Y)
-        real_y = frame_rect->h + off_y;
-    else real_y = 0;
+    if (flip & FLIP_Y)
+        real_y = frame_rect->h + off_y;
+    else real_y = 0;
+
+    if (x) *x += real_x;
+    if (y) *y += real_y;
+    return 0;
+}
+
+void sprite_draw_aframe_abs(sprite_t* spr, int af_index, int x, int y, int flip)
+{
+    int frame_index;
+    int off_x, off_y;
+
+    if (!spr || af_index < 0)
+        return;
+    if (af_index >= spr->aframe_count)
+        return;
+
+    off_x = spr->aframes[af_index].x;
+    off_y = spr->aframes[af_index].y;
+    flip ^= spr->aframes[af_index].flip;
+    frame_index = spr->aframes[af_index].frame_index;
+
+    sprite_draw_frame_abs(spr, frame_index, x + off_x, y + off_y, flip);
+    return;
+}
+
+void sprite_draw_frame_abs(sprite_t* spr, int frame_index, int x, int y, int flip)
+{
+    int real_x, real_y;
+
+    real_x = x;
+    real_y = y;
+    if (sprite_get_abs_frame_vertex(spr, frame_index, flip, &real_x, &real_y))
+        return;
+
+    sprite_draw_frame(spr, frame_index, real_x, real_y, flip);
+    return;
+}
+
+void sprite_draw_aframe(sprite_t* spr, int af_index, int x, int y, int flip)
+{
+    int frame_index;
+    int off_x, off_y;
+    frame_rect_t* bounds;
+
+    if (!spr || af_index < 0)
+        return;
+    if (af_index >= spr->aframe_count)
+        return;
+
+    bounds = &(spr->aframe_bounds[af_index * 4 + (flip & FLIP_XY)]);
+    if (sprite_culled((priv_data_t*)spr->private_data, x + bounds->x, y + bounds->y, bounds->w, bounds->h))
+        return;
+
+    off_x = spr->aframes[af_index].x;
+    off_y = spr->aframes[af_index].y;
+    flip ^= spr->aframes[af_index].flip;
+    frame_index = spr->aframes[af_index].frame_index;
+
+    sprite_draw_frame(spr, frame_index, x + off_x, y + off_y, flip);
+    return;
+}
+
+void sprite_draw_frame(sprite_t* spr, int frame_index, int x, int y, int flip)
+{
+    int count;
+    int offset;
+    priv_data_t* private_data;
+
+    if (!spr || frame_index < 0)
+        return;
+    if (frame_index >= spr->frame_count)
+        return;
+
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->has_viewport) {
+        frame_rect_t* bounds = &(spr->frame_bounds[frame_index * 4 + (flip & FLIP_XY)]);
+        if (sprite_culled(private_data, x + bounds->x, y + bounds->y, bounds->w, bounds->h))
+            return;
+    }
+
+    if (private_data->frame_cache) {
+        frame_cache_t* entry = sprite_frame_cache_get(spr, frame_index, flip);
+        if (entry) {
+            if (entry->module)
+                spr->tex_op->module_paint(entry->module, x + entry->x, y + entry->y, 0, spr->user_data);
+            return;
+        }
+    }
+
+    count = spr->frames[frame_index].count;
+    offset = spr->frames[frame_index].offset;
+    for (int i = 0; i < count; i++) {
+        sprite_draw_frame_module_impl(spr, i + offset, x, y, flip, 1);
+    }
+    return;
+}
+
+void sprite_draw_frame_module(sprite_t* spr, int fm_index, int x, int y, int flip)
+{
+    sprite_draw_frame_module_impl(spr, fm_index, x, y, flip, 0);
+    return;
+}
+
+// SPRITE_LOAD_TRIM, moves the draw of a whole module onto the part that was
+// uploaded. 0 while that part is not known yet
+static int sprite_trim_place(const sprite_t* spr, int idx, int flip, int* x, int* y, int* w, int* h)
+{
+    const trim_t* t;
+    const priv_data_t* private_data;
+
+    private_data = (const priv_data_t*)spr->private_data;
+    if (!private_data->module_trim)
+        return 0;
+    t = &(private_data->module_trim[idx]);
+    if (!t->w)
+        return 0;
+
+    *x += (flip & FLIP_X) ? *w - t->x - t->w : t->x;
+    *y += (flip & FLIP_Y) ? *h - t->y - t->h : t->y;
+    *w = t->w;
+    *h = t->h;
+    return 1;
+}
+
+void sprite_draw_module(sprite_t* spr, int module_index, int x, int y, int flip)
+{
+    int idx;
+    int w, h;
+    int placed;
+    int cur_pal;
+    void* module;
+    void* user_data;
+    const tex_prim_t* prim;
+    priv_data_t* private_data;
+
+    if (!spr || module_index < 0)
+        return;
+    if (module_index >= spr->module_count)
+        return;
+
+    private_data = (priv_data_t*)spr->private_data;
+    cur_pal = spr->cur_palette;
+    idx = module_index + cur_pal * spr->module_count;
+    w = spr->module_dims[module_index].w;
+    h = spr->module_dims[module_index].h;
+    prim = sprite_module_prim(spr, module_index);
+    if (prim) {
+        if (prim->type == BS_PRIM_MARKER || !spr->tex_op->prim_paint || sprite_culled(private_data, x, y, w, h))
+            return;
+        spr->tex_op->prim_paint(prim, x, y, flip, spr->user_data);
+        return;
+    }
+    placed = sprite_trim_place(spr, idx, flip, &x, &y, &w, &h);
+    if (sprite_culled(private_data, x, y, w, h))
+        return;
+
+    user_data = spr->user_data;
+    if (private_data->module_alpha[idx] == TEX_ALPHA_EMPTY)
+        return;
+    if (private_data->load_flags & SPRITE_LOAD_INDEXED) {
+        module = sprite_indexed_module(spr, module_index, cur_pal);
+        if (!module)
+            return;
+        spr->tex_op->module_paint(module, x, y, flip, user_data);
+        return;
+    }
+
+    module = spr->modules[idx];
+    if (!module) {
+        // decode on first draw for this (module, palette), or again when
+        // the warmup of a preloaded palette could not make it
+        module = sprite_decode_module(spr, module_index, cur_pal, NULL);
+        spr->modules[idx] = module;
+        if (!module)
+            return;
+        // the decode just told which part was uploaded
+        if (!placed)
+            sprite_trim_place(spr, idx, flip, &x, &y, &w, &h);
+    }
+    spr->tex_op->module_paint(module, x, y, flip, user_data);
+    return;
+}
+
+int sprite_change_palette(sprite_t* spr, int pal_index)
+{
+    priv_data_t* private_data;
+
+    if (!spr || pal_index < 0)
+        return -1;
+    if (pal_index >= spr->palette_count)
+        return -2;
+    if (sprite_batch_active(spr))
+        return -3;
+
+    sprite_async_cancel(spr);
+    sprite_set_cur_palette(spr, pal_index);
+    private_data = (priv_data_t*)spr->private_data;
+    // lazy sprites decode on draw, indexed ones re-apply the palette on draw
+    if (private_data->load_flags & (SPRITE_LOAD_LAZY | SPRITE_LOAD_INDEXED))
+        return 0;
+    if (pal_index >= private_data->lazy_palette)
+        return 0;
+
+    return sprite_warmup_palette(spr, pal_index);
+}
+
+int sprite_change_palette_async(sprite_t* spr, int pal_index, int thread_count)
+{
+    int offset;
+    int todo_count;
+    int needed_size;
+    uint8_t* p;
+    async_t* job;
+    priv_data_t* private_data;
+
+    if (!spr || pal_index < 0)
+        return -1;
+    if (pal_index >= spr->palette_count)
+        return -2;
+
+    sprite_async_cancel(spr);
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->load_flags & SPRITE_LOAD_INDEXED) {
+        // nothing to decode, switching is already cheap
+        sprite_set_cur_palette(spr, pal_index);
+        return 0;
+    }
+
+    offset = pal_index * spr->module_count;
+    todo_count = 0;
+    for (int i = 0; i < spr->module_count; i++) {
+        if (!spr->modules[i + offset] && !sprite_module_empty(spr, i, pal_index) && !sprite_module_prim(spr, i))
+            todo_count++;
+    }
+    if (!todo_count) {
+        sprite_set_cur_palette(spr, pal_index);
+        return 0;
+    }
+
+    if (thread_count <= 0)
+        thread_count = thread_get_cpu_count() - 1;
+    if (thread_count <= 0)
+        thread_count = 1;
+    if (thread_count > todo_count)
+        thread_count = todo_count;
+
+    // one block for the job and all of its arrays
+    needed_size = sizeof(async_t);
+    needed_size += todo_count * (sizeof(uint32_t*) + sizeof(texture_info_t) + sizeof(int) + sizeof(uint8_t));
+    needed_size += thread_count * sizeof(thread_t*);
+    p = (uint8_t*)calloc(1, needed_size);
+    if (!p)
+        return -3;
+
+    job = (async_t*)p;
+    p += sizeof(async_t);
+    job->pixels = (uint32_t**)p;
+    p += todo_count * sizeof(uint32_t*);
+    job->threads = (thread_t**)p;
+    p += thread_count * sizeof(thread_t*);
+    job->info = (texture_info_t*)p;
+    p += todo_count * sizeof(texture_info_t);
+    job->todo = (int*)p;
+    p += todo_count * sizeof(int);
+    job->state = p;
+
+    job->spr = spr;
+    job->pal_index = pal_index;
+    job->todo_count = 0;
+    for (int i = 0; i < spr->module_count; i++) {
+        if (!spr->modules[i + offset] && !sprite_module_empty(spr, i, pal_index) && !sprite_module_prim(spr, i))
+            job->todo[job->todo_count++] = i;
+    }
+
+    job->lock = mutex_create();
+    if (job->lock) {
+        for (int i = 0; i < thread_count; i++) {
+            thread_t* thread = thread_create(sprite_async_worker, "sprite_decode", job);
+            if (!thread)
+                break;
+            job->threads[job->thread_count++] = thread;
+        }
+    }
+    // without threads sprite_update_palette_async decodes on the caller
+    private_data->async = job;
+    return 0;
+}
+
+int sprite_update_palette_async(sprite_t* spr, int max_uploads)
+{
+    int offset;
+    int uploads;
+    async_t* job;
+    priv_data_t* private_data;
+
+    if (!spr)
+        return -1;
+
+    private_data = (priv_data_t*)spr->private_data;
+    job = private_data->async;
+    if (!job)
+        return 0;
+    if (sprite_batch_active(spr))
+        return 1;
+
+    offset = job->pal_index * spr->module_count;
+    uploads = 0;
+    for (int i = 0; i < job->todo_count; i++) {
+        int state;
+        int module_index;
+        uint32_t* pixels;
+        texture_info_t result;
+
+        if (max_uploads > 0 && uploads >= max_uploads)
+            break;
+
+        mutex_lock(job->lock);
+        if (!job->thread_count && job->state[i] == ASYNC_PENDING) {
+            // no workers, decode here
+            job->pixels[i] = sprite_decode_texels(spr, job->todo[i], job->pal_index, &job->info[i]);
+            job->state[i] = ASYNC_READY;
+        }
+        state = job->state[i];
+        pixels = job->pixels[i];
+        result = job->info[i];
+        if (state == ASYNC_READY) {
+            job->pixels[i] = NULL;
+            job->state[i] = ASYNC_UPLOADED;
+        }
+        mutex_unlock(job->lock);
+        if (state != ASYNC_READY)
+            continue;
+
+        module_index = job->todo[i];
+        if (pixels)
+            private_data->module_alpha[module_index + offset] = (uint8_t)result.alpha;
+        if (pixels && result.alpha != TEX_ALPHA_EMPTY && !spr->modules[module_index + offset]) {
+            void* module = spr->tex_op->module_new(pixels, result.w, result.h,
+                private_data->texel_format, spr->user_data);
+
+            if (module && spr->tex_op->module_alpha)
+                spr->tex_op->module_alpha(module, result.alpha, spr->user_data);
+            if (module && private_data->module_trim)
+                sprite_set_trim(spr, module_index + offset, &result);
+            spr->modules[module_index + offset] = module;
+        }
+        if (pixels)
+            free(pixels);
+        job->uploaded++;
+        uploads++;
+    }
+
+    if (job->uploaded < job->todo_count)
+        return 1;
 
-    if (x) *x += real_x;
-    if (y) *y += real_y;
+    // complete, switch over
+    sprite_set_cur_palette(spr, job->pal_index);
+    sprite_async_free(job);
+    private_data->async = NULL;
     return 0;
 }
 
-void sprite_draw_aframe_abs(sprite_t* spr, int af_index, int x, int y, int flip)
+int sprite_warmup_palette(sprite_t* spr, int pal_index)
 {
-    int frame_index;
-    int off_x, off_y;
+    int offset;
+    int module_count;
+    void** modules;
+    priv_data_t* private_data;
 
-    if (!spr || af_index < 0)
-        return;
-    if (af_index >= spr->aframe_count)
-        return;
+    if (!spr || pal_index < 0)
+        return -1;
+    if (pal_index >= spr->palette_count)
+        return -2;
 
-    off_x = spr->aframes[af_index].x;
-    off_y = spr->aframes[af_index].y;
-    flip ^= spr->aframes[af_index].flip;
-    frame_index = spr->aframes[af_index].frame_index;
+    modules = spr->modules;
+    module_count = spr->module_count;
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->load_flags & SPRITE_LOAD_INDEXED) {
+        for (int i = 0; i < module_count; i++) {
+            sprite_indexed_module(spr, i, pal_index);
+        }
+        return 0;
+    }
 
-    sprite_draw_frame_abs(spr, frame_index, x + off_x, y + off_y, flip);
-    return;
+    offset = pal_index * module_count;
+    for (int i = 0; i < module_count; i++) {
+        int idx = i + offset;
+
+        if (modules[idx] || private_data->module_alpha[idx] == TEX_ALPHA_EMPTY)
+            continue;
+        modules[idx] = sprite_decode_module(spr, i, pal_index, NULL);
+    }
+    return 0;
 }
 
-void sprite_draw_frame_abs(sprite_t* spr, int frame_index, int x, int y, int flip)
+int sprite_rotate_palette(sprite_t* spr, int pal_index, int first, int count, int step)
 {
-    int real_x, real_y;
+    priv_data_t* private_data;
 
-    real_x = x;
-    real_y = y;
-    if (sprite_get_abs_frame_vertex(spr, frame_index, flip, &real_x, &real_y))
-        return;
+    if (!spr || pal_index < 0)
+        return -1;
+    if (pal_index >= spr->palette_count)
+        return -2;
 
-    sprite_draw_frame(spr, frame_index, real_x, real_y, flip);
-    return;
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->async && private_data->async->pal_index == pal_index)
+        return -3;
+    if (sprite_build_index_usage(spr))
+        return -4;
+    if (palette_rotate(palette_get((palettes_t*)(spr->palettes), pal_index), first, count, step))
+        return -1;
+
+    sprite_palette_changed(spr, pal_index, first, count);
+    return 0;
 }
 
-void sprite_draw_aframe(sprite_t* spr, int af_index, int x, int y, int flip)
+int sprite_set_palette_colors(sprite_t* spr, int pal_index, int first, int count, const uint32_t* colors)
 {
-    int frame_index;
-    int off_x, off_y;
+    priv_data_t* private_data;
 
-    if (!spr || af_index < 0)
-        return;
-    if (af_index >= spr->aframe_count)
-        return;
+    if (!spr || pal_index < 0)
+        return -1;
+    if (pal_index >= spr->palette_count)
+        return -2;
 
-    off_x = spr->aframes[af_index].x;
-    off_y = spr->aframes[af_index].y;
-    flip ^= spr->aframes[af_index].flip;
-    frame_index = spr->aframes[af_index].frame_index;
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->async && private_data->async->pal_index == pal_index)
+        return -3;
+    if (sprite_build_index_usage(spr))
+        return -4;
+    if (palette_set_colors(palette_get((palettes_t*)(spr->palettes), pal_index), first, count, colors))
+        return -1;
 
-    sprite_draw_frame(spr, frame_index, x + off_x, y + off_y, flip);
-    return;
+    sprite_palette_changed(spr, pal_index, first, count);
+    return 0;
 }
 
-void sprite_draw_frame(sprite_t* spr, int frame_index, int x, int y, int flip)
+int sprite_add_palette_act(sprite_t* spr, file_handle_t* handle)
 {
+    int size;
     int count;
-    int offset;
+    uint8_t data[PALETTE_ACT_EXT_SIZE];
+    uint32_t colors[256];
+    palettes_t* palettes;
+    priv_data_t* private_data;
 
-    if (!spr || frame_index < 0)
-        return;
-    if (frame_index >= spr->frame_count)
-        return;
+    if (!spr || !handle)
+        return -1;
 
-    count = spr->frames[frame_index].count;
-    offset = spr->frames[frame_index].offset;
-    for (int i = 0; i < count; i++) {
-        sprite_draw_frame_module_impl(spr, i + offset, x, y, flip, 1);
-    }
-    return;
+    // workers read the palette being replaced
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->async)
+        return -3;
+
+    if (file_read(handle, data, PALETTE_ACT_SIZE))
+        return -2;
+    // a plain table ends here, the longer form goes on with its trailer
+    size = PALETTE_ACT_SIZE;
+    if (!file_read(handle, data + PALETTE_ACT_SIZE, PALETTE_ACT_EXT_SIZE - PALETTE_ACT_SIZE))
+        size = PALETTE_ACT_EXT_SIZE;
+    count = palette_parse_act(data, size, colors);
+    if (count < 0)
+        return -2;
+
+    // nothing is decoded for it here, see lazy_palette
+    if (sprite_grow_palettes(spr, spr->palette_count + 1))
+        return -4;
+    palettes = palettes_append((palettes_t*)(spr->palettes), colors, count);
+    if (!palettes)
+        return -4;
+    spr->palettes = (void*)palettes;
+    return spr->palette_count++;
 }
 
-void sprite_draw_frame_module(sprite_t* spr, int fm_index, int x, int y, int flip)
+uint32_t* sprite_get_module_pixels(sprite_t* spr, int module_index, int pal_index)
 {
-    sprite_draw_frame_module_impl(spr, fm_index, x, y, flip, 0);
-    return;
+    if (!spr || module_index < 0 || pal_index < 0)
+        return NULL;
+    if (module_index >= spr->module_count || pal_index >= spr->palette_count)
+        return NULL;
+
+    return sprite_decode_pixels(spr, module_index, pal_index);
 }
 
-void sprite_draw_module(sprite_t* spr, int module_index, int x, int y, int flip)
+int sprite_get_module_pixels_to(sprite_t* spr, int module_index, int pal_index, uint32_t* out, int pitch)
 {
-    int cur_pal;
-    void* module;
-    void* user_data;
+    dim_t* dim;
+    info_t* info;
+    const tex_prim_t* prim;
+    priv_data_t* private_data;
 
-    if (!spr || module_index < 0)
-        return;
-    if (module_index >= spr->module_count)
-        return;
+    if (!spr || !out || module_index < 0 || pal_index < 0)
+        return -1;
+    if (module_index >= spr->module_count || pal_index >= spr->palette_count)
+        return -2;
 
-    cur_pal = spr->cur_palette;
-    module_index += cur_pal * spr->module_count;
-    module = spr->modules[module_index];
-    user_data = spr->user_data;
-    if (!module) {
-        if (sprite_change_palette(spr, cur_pal))
-            return;
-        module = spr->modules[module_index];
+    prim = sprite_module_prim(spr, module_index);
+    if (prim) {
+        sprite_prim_pixels(prim, out, pitch);
+        return 0;
     }
-    module_paint(module, x, y, flip, user_data);
-    return;
+
+    private_data = (priv_data_t*)spr->private_data;
+    dim = &(spr->module_dims[module_index]);
+    info = &(private_data->infos[module_index]);
+    return texture_decode_to(private_data->data + info->data_offset, info->data_len, private_data->encode_format,
+        palette_get((palettes_t*)(spr->palettes), pal_index), dim->w, dim->h, out, pitch);
 }
 
-int sprite_change_palette(sprite_t* spr, int pal_index)
+int sprite_get_module_alpha(sprite_t* spr, int module_index, int pal_index)
 {
-    int offset;
-    int module_count;
-    void* temp;
-    dim_t* dims;
-    void** modules;
-    palette_t* pal;
-
-    int data_len;
-    int data_offset;
-    int tex_w, tex_h;
-    uint16_t encode_format;
-    uint8_t* tex_data;
-    info_t* infos;
     priv_data_t* private_data;
 
-    void* user_data;
+    if (!spr || module_index < 0 || pal_index < 0)
+        return TEX_ALPHA_UNKNOWN;
+    if (module_index >= spr->module_count || pal_index >= spr->palette_count)
+        return TEX_ALPHA_UNKNOWN;
 
-    if (!spr || pal_index < 0)
-        return -1;
-    if (pal_index >= spr->palette_count)
-        return -2;
+    private_data = (priv_data_t*)spr->private_data;
+    return private_data->module_alpha[module_index + pal_index * spr->module_count];
+}
 
-    dims = spr->module_dims;
-    modules = spr->modules;
-    module_count = spr->module_count;
-    offset = pal_index * module_count;
-    pal = palette_get((palettes_t*)(spr->palettes), pal_index);
+void* sprite_get_module(sprite_t* spr, int module_index, int pal_index)
+{
+    priv_data_t* private_data;
 
-    private_data = (priv_data_t*)spr->private_data;
-    encode_format = private_data->encode_format;
-    tex_data = private_data->data;
-    infos = private_data->infos;
+    if (!spr || module_index < 0 || pal_index < 0)
+        return NULL;
+    if (module_index >= spr->module_count || pal_index >= spr->palette_count)
+        return NULL;
 
-    user_data = spr->user_data;
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->load_flags & SPRITE_LOAD_INDEXED) {
+        if (private_data->index_pal[module_index] != pal_index)
+            return NULL;
+        return spr->modules[module_index];
+    }
+    return spr->modules[module_index + pal_index * spr->module_count];
+}
 
-    spr->cur_palette = pal_index;
-    for (int i = 0; i < module_count; i++) {
-        int idx = i + offset;
+int sprite_set_module(sprite_t* spr, int module_index, int pal_index, void* module)
+{
+    int idx;
+    priv_data_t* private_data;
 
-        temp = modules[idx];
-        if (temp)
-            continue;
+    if (!spr || module_index < 0 || pal_index < 0)
+        return -1;
+    if (module_index >= spr->module_count || pal_index >= spr->palette_count)
+        return -2;
 
-        tex_w = dims[i].w;
-        tex_h = dims[i].h;
-        data_len = infos[i].data_len;
-        data_offset = infos[i].data_offset;
-        temp = texture_load(tex_data + data_offset, data_len, encode_format,
-            pal, tex_w, tex_h, user_data);
-        modules[idx] = temp;
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data->load_flags & SPRITE_LOAD_INDEXED)
+        idx = module_index;
+    else
+        idx = module_index + pal_index * spr->module_count;
+
+    if (spr->modules[idx])
+        spr->tex_op->module_free(spr->modules[idx], spr->user_data);
+    spr->modules[idx] = module;
+    if (private_data->load_flags & SPRITE_LOAD_INDEXED)
+        private_data->index_pal[module_index] = pal_index;
+    if (private_data->module_trim) {
+        texture_info_t full = { TEX_ALPHA_UNKNOWN, 0, 0, spr->module_dims[module_index].w, spr->module_dims[module_index].h };
+
+        // without a module the next decode tells the rect again
+        if (!module)
+            full.w = 0;
+        sprite_set_trim(spr, idx, &full);
     }
     return 0;
 }
@@ -290,6 +1843,7 @@ void sprite_free_module_cache(sprite_t* spr, int pal_index)
     void* temp;
     void** modules;
     void* user_data;
+    priv_data_t* private_data;
 
     if (!spr || pal_index < 0)
         return;
@@ -300,40 +1854,82 @@ void sprite_free_module_cache(sprite_t* spr, int pal_index)
     user_data = spr->user_data;
     module_count = spr->module_count;
     offset = pal_index * module_count;
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data && (private_data->load_flags & SPRITE_LOAD_INDEXED)) {
+        // textures live in the first row, tagged with their palette
+        for (int i = 0; i < module_count; i++) {
+            temp = modules[i];
+            if (temp && private_data->index_pal[i] == pal_index) {
+                spr->tex_op->module_free(temp, user_data);
+                modules[i] = NULL;
+            }
+        }
+        return;
+    }
     for (int i = 0; i < module_count; i++) {
         int idx = i + offset;
 
         temp = modules[idx];
         if (temp) {
-            module_free(temp, user_data);
+            spr->tex_op->module_free(temp, user_data);
             modules[idx] = NULL;
         }
     }
     return;
 }
 
+void sprite_free_scratch(void)
+{
+    texture_scratch_free(&render_scratch);
+    return;
+}
+
 void sprite_free(sprite_t* spr)
 {
     int pal_count;
     palettes_t* palettes;
+    priv_data_t* private_data;
 
     if (!spr)
         return;
 
+    sprite_async_cancel(spr);
     pal_count = spr->palette_count;
     palettes = (palettes_t*)(spr->palettes);
     for (int i = 0; i < pal_count; i++) {
+        sprite_free_frame_cache(spr, i);
         sprite_free_module_cache(spr, i);
     }
+    private_data = (priv_data_t*)spr->private_data;
+    if (private_data && private_data->indices) {
+        for (int i = 0; i < spr->module_count; i++) {
+            if (private_data->indices[i])
+                free(private_data->indices[i]);
+        }
+    }
+    if (private_data && private_data->index_usage)
+        free(private_data->index_usage);
+    if (private_data && private_data->palette_block)
+        free(private_data->palette_block);
     palettes_free(palettes);
 
     free(spr);
     return;
 }
 
-sprite_t* sprite_load(file_handle_t* handle, void *user_data)
+sprite_t* sprite_load(file_handle_t* handle, void* user_data)
+{
+    return sprite_load_ex(handle, user_data, 0);
+}
+
+sprite_t* sprite_load_ex(file_handle_t* handle, void* user_data, int load_flags)
+{
+    return sprite_load_custom(handle, tex_get_global_op(), user_data, load_flags);
+}
+
+sprite_t* sprite_load_custom(file_handle_t* handle, const tex_op_t* tex_op, void* user_data, int load_flags)
 {
-    size_t file_offset;
+    size_t encode_pos;
 
     int needed_size;
 
@@ -343,21 +1939,49 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
     // temps
     uint8_t u8t;
     uint16_t u16t;
+    uint32_t u32t;
+    uint32_t bs_flags;
+    bs_layout_t layout;
     uint8_t* buffer; // store palettes data
+    uint8_t* raw;    // records of every section, parsed once the block exists
+    int raw_len;
+    dim_t* dims;
+    tex_prim_t* prims;
+
+    // section offsets in raw
+    int module_off;
+    int fmodule_off;
+    int frame_off;
+    int rect_off;
+    int coll_off;
+    int aframe_off;
+    int anim_off;
 
     dim_t* module_dims;
     void** modules;
     fmodule_t* fmodules;
     frame_t* frames;
     frame_rect_t* frame_rects;
+    frame_rect_t* frame_bounds;
+    frame_rect_t* frame_colls;
     aframe_t* aframes;
+    frame_rect_t* aframe_bounds;
     anim_t* anims;
     info_t* infos;
+    tex_prim_t* module_prims;
     priv_data_t* priv_data;
     uint8_t* encode_data;
+    uint8_t** indices;
+    int* index_pal;
+    frame_cache_t* frame_cache;
+    uint64_t* masks;
+    int* mask_offsets;
+    uint8_t* module_alpha;
+    trim_t* module_trim;
 
     // counter
     int module_count;
+    int mask_words;
     int fmodule_count;
     int frame_count;
     int aframe_count;
@@ -374,56 +1998,101 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
     uint16_t encode_format;
     int encode_data_size;
 
+    if (!tex_op)
+        return NULL;
+
     res = NULL;
     buffer = NULL;
+    raw = NULL;
+    raw_len = 0;
+    dims = NULL;
+    prims = NULL;
+    infos = NULL;
+    priv_data = NULL;
     needed_size = 0;
 
-    // check magic header
-    const static uint8_t magic[] = { 0xdf, 0x03, 0x01, 0x01, 0x01, 0x01 };
-    {
-        uint8_t magic_tmp[sizeof(magic)];
-        if (file_read(handle, magic_tmp, sizeof(magic_tmp))) FAIL();
-        for (int i = 0; i < sizeof(magic); i++) {
-            if (magic_tmp[i] != magic[i]) FAIL();
-        }
-    }
-
-    if (file_pos(handle, &file_offset)) FAIL();
+    // before any decode job of this sprite can start a thread
+    texture_init();
 
-    // first pass for needed memory size
+    // check header, its flags pick the record readers
     file_set_global_endian(ENDIAN_LE);
+    if (file_get_u16(handle, &u16t)) FAIL();
+    if (file_get_u32(handle, &bs_flags)) FAIL();
+    if (bs_layout_init(&layout, u16t, bs_flags)) FAIL();
+
+    // first pass for needed memory size, the records of each section are
+    // read in one go and parsed from raw in the second one
 
     // Module
     if (file_get_u16(handle, &u16t)) FAIL();
     module_count = u16t;
-    if (file_seek(handle, module_count * 2, FSEEK_CUR)) FAIL();
-
-    // FModule
-    if (file_get_u16(handle, &u16t)) FAIL();
-    fmodule_count = u16t;
-    if (fmodule_count) {
-        if (file_seek(handle, fmodule_count * 4, FSEEK_CUR)) FAIL();
+    module_off = raw_len;
+    if (sprite_read_modules(handle, &layout, module_count, &raw, &raw_len, &prims)) FAIL();
+    // file_seek takes no 0 offset, a sprite may have no modules
+    if (bs_flags & BS_MODULES_USAGE) {
+        if (module_count && file_seek(handle, module_count, FSEEK_CUR)) FAIL();
     }
-
-    // Frame
-    if (file_get_u16(handle, &u16t)) FAIL();
-    frame_count = u16t;
-    if (frame_count) {
-        if (file_seek(handle, frame_count * 8, FSEEK_CUR)) FAIL();
+    // no modules leave dims NULL
+    if (module_count) {
+        dims = (dim_t*)malloc(module_count * sizeof(dim_t));
+        if (!dims) FAIL();
+        layout.read_dims(raw + module_off + layout.module_head, module_count, layout.module_size, dims);
+    }
+    for (int i = 0; i < module_count && prims; i++) {
+        if (prims[i].type) {
+            dims[i].w = prims[i].w;
+            dims[i].h = prims[i].h;
+        }
+    }
+    mask_words = 0;
+    for (int i = 0; i < module_count; i++) {
+        mask_words += TEXTURE_MASK_WORDS(dims[i].w) * dims[i].h;
     }
 
-    // AFrame
-    if (file_get_u16(handle, &u16t)) FAIL();
-    aframe_count = u16t;
-    if (aframe_count) {
-        if (file_seek(handle, aframe_count * 5, FSEEK_CUR)) FAIL();
+    // FModule, Frame rect and Frame
+    fmodule_count = 0;
+    frame_count = 0;
+    fmodule_off = frame_off = rect_off = coll_off = raw_len;
+    if (bs_flags & BS_FRAMES) {
+        if (file_get_u16(handle, &u16t)) FAIL();
+        fmodule_count = u16t;
+        fmodule_off = raw_len;
+        if (sprite_read_section(handle, &raw, &raw_len, fmodule_count * layout.fmodule_size)) FAIL();
+
+        // hit rects of BS_FRAME_RECTS are not kept
+        if (bs_flags & BS_FRAME_RECTS) {
+            if (file_get_u16(handle, &u16t)) FAIL();
+            if (u16t && file_seek(handle, u16t * layout.rect_size, FSEEK_CUR)) FAIL();
+        }
+
+        if (file_get_u16(handle, &u16t)) FAIL();
+        frame_count = u16t;
+        frame_off = raw_len;
+        if (sprite_read_section(handle, &raw, &raw_len, frame_count * layout.frame_size)) FAIL();
+        rect_off = raw_len;
+        if (!(bs_flags & BS_SKIP_FRAME_RC)) {
+            if (sprite_read_section(handle, &raw, &raw_len, frame_count * layout.rect_size)) FAIL();
+        }
+        coll_off = raw_len;
+        if (bs_flags & BS_FRAME_COLL_RC) {
+            if (sprite_read_section(handle, &raw, &raw_len, frame_count * layout.rect_size)) FAIL();
+        }
     }
 
-    // Anim
-    if (file_get_u16(handle, &u16t)) FAIL();
-    anim_count = u16t;
-    if (anim_count) {
-        if (file_seek(handle, anim_count * 4, FSEEK_CUR)) FAIL();
+    // AFrame and Anim
+    aframe_count = 0;
+    anim_count = 0;
+    aframe_off = anim_off = raw_len;
+    if (bs_flags & BS_ANIMS) {
+        if (file_get_u16(handle, &u16t)) FAIL();
+        aframe_count = u16t;
+        aframe_off = raw_len;
+        if (sprite_read_section(handle, &raw, &raw_len, aframe_count * layout.aframe_size)) FAIL();
+
+        if (file_get_u16(handle, &u16t)) FAIL();
+        anim_count = u16t;
+        anim_off = raw_len;
+        if (sprite_read_section(handle, &raw, &raw_len, anim_count * layout.anim_size)) FAIL();
     }
 
     // Palette
@@ -434,15 +2103,23 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
     if (file_get_u8(handle, &u8t)) FAIL();
     color_count = u8t;
     palette_size = pixel_size * palette_count * color_count;
-    if (file_seek(handle, palette_size, FSEEK_CUR)) FAIL();
+    // palettes_load takes no empty palette either
+    if (palette_size <= 0) FAIL();
+    buffer = (uint8_t*)malloc(palette_size);
+    if (!buffer) FAIL();
+    if (file_read(handle, buffer, palette_size)) FAIL();
 
     // Module image data
     encode_data_size = 0;
     if (file_get_u16(handle, &encode_format)) FAIL();
+    if (file_pos(handle, &encode_pos)) FAIL();
     for (int i = 0; i < module_count; i++) {
-        if (file_get_u16(handle, &u16t)) FAIL();
-        if (file_seek(handle, u16t, FSEEK_CUR)) FAIL();
-        encode_data_size += u16t;
+        if (sprite_read_image_size(handle, &layout, &u32t)) FAIL();
+        if (u32t > (uint32_t)(INT32_MAX - encode_data_size)) FAIL();
+        // shapes and markers have no data, file_seek takes no 0 offset
+        if (u32t && file_seek(handle, u32t, FSEEK_CUR)) FAIL();
+        if (sprite_skip_image_fx(handle, &layout)) FAIL();
+        encode_data_size += u32t;
     }
 
     // calculate memory size and allocate
@@ -450,8 +2127,19 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
     fmodules = NULL;
     frames = NULL;
     frame_rects = NULL;
+    frame_bounds = NULL;
+    frame_colls = NULL;
     aframes = NULL;
+    aframe_bounds = NULL;
     anims = NULL;
+    indices = NULL;
+    index_pal = NULL;
+    frame_cache = NULL;
+    masks = NULL;
+    mask_offsets = NULL;
+    module_alpha = NULL;
+    module_trim = NULL;
+    module_prims = NULL;
 
     while (1) {
         // for sprite_t struct
@@ -459,6 +2147,13 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
             res = (sprite_t*)ptr_offs(p, 0);
         needed_size += sizeof(sprite_t);
 
+        // for spr->private_data->masks, right after sprite_t to stay 8 byte aligned
+        if (load_flags & SPRITE_LOAD_COLL_MASK) {
+            if (p)
+                masks = (uint64_t*)ptr_offs(p, needed_size);
+            needed_size += mask_words * sizeof(uint64_t);
+        }
+
         // for spr->module_dims
         if (p)
             module_dims = (dim_t*)ptr_offs(p, needed_size);
@@ -486,6 +2181,18 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
             if (p)
                 frame_rects = (frame_rect_t*)ptr_offs(p, needed_size);
             needed_size += frame_count * sizeof(frame_rect_t);
+
+            // for spr->frame_bounds
+            if (p)
+                frame_bounds = (frame_rect_t*)ptr_offs(p, needed_size);
+            needed_size += frame_count * 4 * sizeof(frame_rect_t);
+
+            // for spr->frame_colls
+            if (bs_flags & BS_FRAME_COLL_RC) {
+                if (p)
+                    frame_colls = (frame_rect_t*)ptr_offs(p, needed_size);
+                needed_size += frame_count * sizeof(frame_rect_t);
+            }
         }
 
         // for spr->aframes
@@ -493,6 +2200,11 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
             if (p)
                 aframes = (aframe_t*)ptr_offs(p, needed_size);
             needed_size += aframe_count * sizeof(aframe_t);
+
+            // for spr->aframe_bounds
+            if (p)
+                aframe_bounds = (frame_rect_t*)ptr_offs(p, needed_size);
+            needed_size += aframe_count * 4 * sizeof(frame_rect_t);
         }
 
         // for spr->anims
@@ -512,6 +2224,52 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
             infos = (info_t*)ptr_offs(p, needed_size);
         needed_size += module_count * sizeof(info_t);
 
+        // for spr->private_data->prims
+        if (prims) {
+            if (p)
+                module_prims = (tex_prim_t*)ptr_offs(p, needed_size);
+            needed_size += module_count * sizeof(tex_prim_t);
+        }
+
+        // for spr->private_data->frame_cache
+        if ((load_flags & SPRITE_LOAD_FRAME_CACHE) && frame_count) {
+            if (p)
+                frame_cache = (frame_cache_t*)ptr_offs(p, needed_size);
+            needed_size += frame_count * palette_count * 4 * sizeof(frame_cache_t);
+        }
+
+        if (load_flags & SPRITE_LOAD_INDEXED) {
+            // for spr->private_data->indices
+            if (p)
+                indices = (uint8_t**)ptr_offs(p, needed_size);
+            needed_size += module_count * sizeof(uint8_t*);
+
+            // for spr->private_data->index_pal
+            if (p)
+                index_pal = (int*)ptr_offs(p, needed_size);
+            needed_size += module_count * sizeof(int);
+        }
+
+        // for spr->private_data->mask_offsets
+        if (load_flags & SPRITE_LOAD_COLL_MASK) {
+            if (p)
+                mask_offsets = (int*)ptr_offs(p, needed_size);
+            needed_size += module_count * sizeof(int);
+        }
+
+        // for spr->private_data->module_trim, indexed modules are remade
+        // at full size on every palette change so they stay untrimmed
+        if ((load_flags & SPRITE_LOAD_TRIM) && !(load_flags & SPRITE_LOAD_INDEXED)) {
+            if (p)
+                module_trim = (trim_t*)ptr_offs(p, needed_size);
+            needed_size += module_count * palette_count * sizeof(trim_t);
+        }
+
+        // for spr->private_data->module_alpha
+        if (p)
+            module_alpha = (uint8_t*)ptr_offs(p, needed_size);
+        needed_size += module_count * palette_count;
+
         // for spr->private_data->data
         if (p)
             encode_data = (uint8_t*)ptr_offs(p, needed_size);
@@ -534,117 +2292,115 @@ sprite_t* sprite_load(file_handle_t* handle, void *user_data)
     SET(frame_count);
     SET(frames);
     SET(frame_rects);
+    SET(frame_bounds);
+    SET(frame_colls);
     SET(aframe_count);
     SET(aframes);
+    SET(aframe_bounds);
     SET(anim_count);
     SET(anims);
     SET(palette_count);
+    SET(tex_op);
     SET(user_data);
 #undef SET
     priv_data->infos = infos;
+    priv_data->prims = module_prims;
     priv_data->data = encode_data;
     priv_data->encode_format = encode_format;
+    priv_data->texel_format = texture_pick_format(tex_op, user_data, pixel_format);
+    priv_data->load_flags = load_flags;
+    priv_data->indices = indices;
+    priv_data->index_pal = index_pal;
+    priv_data->frame_cache = frame_cache;
+    priv_data->masks = masks;
+    priv_data->mask_offsets = mask_offsets;
+    priv_data->module_alpha = module_alpha;
+    priv_data->module_trim = module_trim;
+    priv_data->lazy_palette = palette_count;
     res->private_data = (void*)priv_data;
 
     // second pass for parsing
-    if (file_seek(handle, file_offset, FSEEK_SET)) FAIL();
 
     // Module
-    if (file_seek(handle, 2, FSEEK_CUR)) FAIL();
-    for (int i = 0; i < module_count; i++) {
-        uint8_t t[2];
-        if (file_read(handle, t, 2)) FAIL();
-
-        module_dims[i].w = t[0];
-        module_dims[i].h = t[1];
-    }
-
-    // FModule
-    if (file_seek(handle, 2, FSEEK_CUR)) FAIL();
-    for (int i = 0; i < fmodule_count; i++) {
-        uint8_t t[4];
-        if (file_read(handle, t, 4)) FAIL();
-
-        fmodules[i].module_index = t[0];
-        fmodules[i].x = (int8_t)t[1];
-        fmodules[i].y = (int8_t)t[2];
-        fmodules[i].flip = t[3];
-    }
-
-    // Frame
-    if (file_seek(handle, 2, FSEEK_CUR)) FAIL();
-    for (int i = 0; i < frame_count; i++) {
-        uint16_t t[2];
-        if (file_get_u16(handle, &t[0])) FAIL();
-        if (file_get_u16(handle, &t[1])) FAIL();
-
-        frames[i].count = t[0];
-        frames[i].offset = t[1];
-    }
-
-    // Frame rect
-    for (int i = 0; i < frame_count; i++) {
-        uint8_t t[4];
-        if (file_read(handle, t, 4)) FAIL();
-
-        frame_rects[i].x = (int8_t)t[0];
-        frame_rects[i].y = (int8_t)t[1];
-        frame_rects[i].w = t[2];
-        frame_rects[i].h = t[3];
+    if (dims)
+        memcpy(module_dims, dims, module_count * sizeof(dim_t));
+    if (prims)
+        memcpy(module_prims, prims, module_count * sizeof(tex_prim_t));
+    mask_words = 0;
+    for (int i = 0; i < module_count && mask_offsets; i++) {
+        mask_offsets[i] = mask_words;
+        mask_words += TEXTURE_MASK_WORDS(dims[i].w) * dims[i].h;
     }
 
-    // AFrame
-    if (file_seek(handle, 2, FSEEK_CUR)) FAIL();
-    for (int i = 0; i < aframe_count; i++) {
-        uint8_t t[5];
-        if (file_read(handle, t, 5)) FAIL();
+    // FModule, Frame, Frame rect and Frame collision rect
+    layout.read_fmodules(raw + fmodule_off, fmodule_count, fmodules);
+    // triangles keep their first corner on the fmodule position
+    for (int i = 0; i < fmodule_count && prims; i++) {
+        int module_index = fmodules[i].module_index;
 
-        aframes[i].frame_index = t[0];
-        aframes[i].time = t[1];
-        aframes[i].x = (int8_t)t[2];
-        aframes[i].y = (int8_t)t[3];
-        aframes[i].flip = t[4];
+        if (module_index < 0 || module_index >= module_count)
+            continue;
+        fmodules[i].x -= prims[module_index].x[0];
+        fmodules[i].y -= prims[module_index].y[0];
     }
-
-    // Anim
-    if (file_seek(handle, 2, FSEEK_CUR)) FAIL();
+    layout.read_frames(raw + frame_off, frame_count, frames);
+    if (!(bs_flags & BS_SKIP_FRAME_RC))
+        layout.read_rects(raw + rect_off, frame_count, frame_rects);
+    if (frame_colls)
+        layout.read_rects(raw + coll_off, frame_count, frame_colls);
+
+    // AFrame and Anim
+    layout.read_aframes(raw + aframe_off, aframe_count, aframes);
+    layout.read_anims(raw + anim_off, anim_count, anims);
+    // players index aframes and their times through these unchecked
     for (int i = 0; i < anim_count; i++) {
-        uint16_t t[2];
-        if (file_get_u16(handle, &t[0])) FAIL();
-        if (file_get_u16(handle, &t[1])) FAIL();
-
-        anims[i].count = t[0];
-        anims[i].offset = t[1];
+        if (anims[i].offset < 0 || anims[i].offset + anims[i].count > aframe_count) FAIL();
     }
+    free(raw);
+    raw = NULL;
+    free(dims);
+    dims = NULL;
+    if (prims)
+        free(prims);
+    prims = NULL;
+    sprite_compute_bounds(res);
 
     // Palette
-    if (file_seek(handle, 4, FSEEK_CUR)) FAIL();
-    buffer = (uint8_t*)malloc(palette_size);
-    if (!buffer) FAIL();
-    if (file_read(handle, buffer, palette_size)) FAIL();
     palettes = palettes_load(buffer, pixel_format, palette_count, color_count);
     if (!palettes) FAIL();
     res->palettes = (void*)palettes;
+    if (palettes_set_texel_format(palettes, priv_data->texel_format)) FAIL();
     free(buffer);
+    buffer = NULL;
 
     // Module image data
     encode_data_off = 0;
-    if (file_seek(handle, 2, FSEEK_CUR)) FAIL();
+    if (file_seek(handle, (long)encode_pos, FSEEK_SET)) FAIL();
     for (int i = 0; i < module_count; i++) {
-        if (file_get_u16(handle, &u16t)) FAIL();
-        infos[i].data_len = u16t;
+        if (sprite_read_image_size(handle, &layout, &u32t)) FAIL();
+        infos[i].data_len = (int)u32t;
         infos[i].data_offset = encode_data_off;
 
-        if (file_read(handle, encode_data + encode_data_off, u16t)) FAIL();
-        encode_data_off += u16t;
+        if (u32t && file_read(handle, encode_data + encode_data_off, u32t)) FAIL();
+        if (sprite_skip_image_fx(handle, &layout)) FAIL();
+        encode_data_off += u32t;
     }
 
-    sprite_change_palette(res, 0);
+    if (load_flags & SPRITE_LOAD_COLL_MASK)
+        sprite_build_masks(res);
+    if (!(load_flags & SPRITE_LOAD_LAZY))
+        sprite_warmup_palette(res, 0);
     return res;
 
 fail:
     if (buffer)
         free(buffer);
+    if (raw)
+        free(raw);
+    if (dims)
+        free(dims);
+    if (prims)
+        free(prims);
     if (res)
         sprite_free(res);
     return NULL;
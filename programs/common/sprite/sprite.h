@@ -27,6 +27,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include "engine_tex_impl.h"
 #include "file_impl.h"
 
 #ifdef __cplusplus
@@ -38,6 +39,13 @@ extern "C" {
 #define FLIP_Y  (0x2)
 #define FLIP_XY (FLIP_X|FLIP_Y)
 
+// sprite_load_ex flags
+#define SPRITE_LOAD_LAZY    (0x1) // decode a module on its first draw
+#define SPRITE_LOAD_INDEXED (0x2) // keep 8-bit indices, apply the palette at draw time
+#define SPRITE_LOAD_FRAME_CACHE (0x4) // compose each (frame, palette, flip) into one texture on first draw
+#define SPRITE_LOAD_COLL_MASK   (0x8) // keep a 1-bit opacity mask per module (palette 0) for pixel overlap tests
+#define SPRITE_LOAD_TRIM        (0x10) // upload modules without their transparent border, not with SPRITE_LOAD_INDEXED
+
 // structs
 typedef struct dim_s
 {
@@ -92,9 +100,12 @@ typedef struct sprite_s
     int frame_count;
     frame_t *frames;
     frame_rect_t *frame_rects;
+    frame_rect_t *frame_bounds;  // 4 per frame (by flip), box of its fmodules around the draw point
+    frame_rect_t *frame_colls;   // BS_FRAME_COLL_RC, NULL when the file has none
 
     int aframe_count;
     aframe_t *aframes;
+    frame_rect_t *aframe_bounds; // 4 per aframe (by flip), same for the aframe draw point
 
     int anim_count;
     anim_t *anims;
@@ -104,6 +115,7 @@ typedef struct sprite_s
     void *private_data;
 
     // for texture create
+    const tex_op_t *tex_op;
     void *user_data;
 } sprite_t;
 
@@ -119,11 +131,72 @@ void sprite_draw_frame          (sprite_t *spr, int frame_index,   int x, int y,
 void sprite_draw_frame_module   (sprite_t *spr, int fm_index,      int x, int y, int flip);
 void sprite_draw_module         (sprite_t *spr, int module_index,  int x, int y, int flip);
 
+// draws that miss the viewport never reach the backend, w or h <= 0 turns it off
+void sprite_set_viewport     (sprite_t *spr, int x, int y, int w, int h);
+int  sprite_get_frame_bounds (sprite_t *spr, int frame_index, int flip, frame_rect_t *out);
+int  sprite_get_aframe_bounds(sprite_t *spr, int af_index,    int flip, frame_rect_t *out);
+
+// collision rect of a frame drawn at (x, y) with flip, fails without BS_FRAME_COLL_RC
+int  sprite_get_frame_coll   (sprite_t *spr, int frame_index, int x, int y, int flip, frame_rect_t *out);
+int  sprite_get_aframe_coll  (sprite_t *spr, int af_index,    int x, int y, int flip, frame_rect_t *out);
+
+// SPRITE_LOAD_COLL_MASK only, rows of words_per_row words, bit (x & 63) of word (x >> 6) is pixel x
+const uint64_t* sprite_get_module_mask(sprite_t *spr, int module_index, int *words_per_row);
+
+// 1 when opaque pixels of the two frames meet, 0 when not, < 0 on error
+// (-3 when a sprite was loaded without SPRITE_LOAD_COLL_MASK)
+int  sprite_frame_overlap    (sprite_t *spr_a, int frame_a, int xa, int ya, int flip_a,
+                              sprite_t *spr_b, int frame_b, int xb, int yb, int flip_b);
+int  sprite_aframe_overlap   (sprite_t *spr_a, int af_a,    int xa, int ya, int flip_a,
+                              sprite_t *spr_b, int af_b,    int xb, int yb, int flip_b);
+
+// -3 while the backend records a batch, its draws would switch with it
 int  sprite_change_palette   (sprite_t *spr, int pal_index);
+// append the .act palette read from handle, returns its palette index or < 0.
+// its modules are decoded on first draw whatever the load flags, -3 while an
+// async palette change is pending
+int  sprite_add_palette_act  (sprite_t *spr, file_handle_t *handle);
+int  sprite_warmup_palette   (sprite_t *spr, int pal_index);
+
+// decode pal_index on worker threads (thread_count <= 0 picks one per spare core),
+// then call sprite_update_palette_async once per frame on the render thread:
+// it uploads at most max_uploads finished modules (0 for all) and returns 1
+// while pending, 0 once the sprite has switched to the new palette. it waits
+// while the backend records a batch
+int  sprite_change_palette_async(sprite_t *spr, int pal_index, int thread_count);
+int  sprite_update_palette_async(sprite_t *spr, int max_uploads);
+
+// palette animation: rotate colors [first, first + count) of pal_index by step
+// entries (down when negative) or replace them with count ARGB colors. only
+// modules drawing one of those colors are made again, SPRITE_LOAD_INDEXED
+// sprites just re-apply the palette to them. collision masks keep the
+// opacity of load time. -3 while an async change to pal_index is pending
+int  sprite_rotate_palette    (sprite_t *spr, int pal_index, int first, int count, int step);
+int  sprite_set_palette_colors(sprite_t *spr, int pal_index, int first, int count, const uint32_t *colors);
+
 void sprite_free_module_cache(sprite_t *spr, int pal_index);
 
-void        sprite_free   (sprite_t *spr);
-sprite_t*   sprite_load   (file_handle_t *handle, void *user_data);
+// decoded w * h ARGB pixels of a module, caller frees them
+uint32_t* sprite_get_module_pixels(sprite_t *spr, int module_index, int pal_index);
+// decode into caller memory with rows pitch bytes apart, 0 on success
+int       sprite_get_module_pixels_to(sprite_t *spr, int module_index, int pal_index, uint32_t *out, int pitch);
+// TEX_ALPHA_* of a module, TEX_ALPHA_UNKNOWN until it was decoded once.
+// TEX_ALPHA_EMPTY modules are never made nor drawn
+int       sprite_get_module_alpha (sprite_t *spr, int module_index, int pal_index);
+// replace the cached module for (module_index, pal_index), the sprite owns it
+// afterwards. module covers the whole module, trimmed or not
+int       sprite_set_module       (sprite_t *spr, int module_index, int pal_index, void *module);
+// the cached module for (module_index, pal_index), NULL when there is none
+void*     sprite_get_module       (sprite_t *spr, int module_index, int pal_index);
+
+void        sprite_free    (sprite_t *spr);
+// drops the decode buffer the calling thread reuses, e.g. once loading is
+// done. every thread that loads or draws sprites has its own and frees it
+void        sprite_free_scratch(void);
+sprite_t*   sprite_load    (file_handle_t *handle, void *user_data);
+sprite_t*   sprite_load_ex (file_handle_t *handle, void *user_data, int load_flags);
+// modules of the sprite are made by tex_op, the _ex/plain loaders use the global op
+sprite_t*   sprite_load_custom(file_handle_t *handle, const tex_op_t *tex_op, void *user_data, int load_flags);
 
 #ifdef __cplusplus
 }
@@ -24,130 +24,1051 @@
 
 #include "texture.h"
 
+#include <string.h> /* memset, memcpy */
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TEXTURE_HAVE_SIMD
+#include <immintrin.h>
+#endif
+
 #ifndef FREE_PIXEL_DATA
     #define FREE_PIXEL_DATA 1
 #endif
 
-// Forbid memory overflow
-#define SAFE_PUT(x) safe_put(pixels, x, cur_pos++, w * h)
-static inline void safe_put(uint32_t* arr, uint32_t val, size_t index, size_t size)
+// palette lookup of count packed pixels, count never needs more than the encoded bytes
+typedef void (*expand_fn)(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out);
+
+static void expand_i2_c(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out);
+static void expand_i4_c(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out);
+static void expand_i16_c(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out);
+static void expand_i256_c(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out);
+
+// global variables
+// plain C until texture_init picks the kernels of the CPU. only texture_init
+// writes them, once, so decoders on other threads only ever read them
+static expand_fn expand_i2 = expand_i2_c;
+static expand_fn expand_i4 = expand_i4_c;
+static expand_fn expand_i16 = expand_i16_c;
+static expand_fn expand_i256 = expand_i256_c;
+static int kernels_picked;
+
+// private functions
+
+// pixels are packed from the high bits down, bits is constant per caller
+static inline void expand_tail(const uint8_t* data, int i, int count, const uint32_t* lut, uint32_t* out, int bits)
+{
+    int per_byte = 8 / bits;
+    int mask = (1 << bits) - 1;
+
+    for (; i < count; i++) {
+        int shift = 8 - bits * (i % per_byte + 1);
+        out[i] = lut[(data[i / per_byte] >> shift) & mask];
+    }
+    return;
+}
+
+static void expand_i2_c(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    expand_tail(data, 0, count, lut, out, 1);
+    return;
+}
+
+static void expand_i4_c(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    expand_tail(data, 0, count, lut, out, 2);
+    return;
+}
+
+static void expand_i16_c(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    expand_tail(data, 0, count, lut, out, 4);
+    return;
+}
+
+static void expand_i256_c(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    for (int i = 0; i < count; i++) {
+        out[i] = lut[data[i]];
+    }
+    return;
+}
+
+#ifdef TEXTURE_HAVE_SIMD
+// lut[0..15] split into byte planes so PSHUFB looks up 16 pixels per plane
+__attribute__((target("ssse3")))
+static inline void lut_planes_ssse3(const uint32_t* lut, __m128i* planes)
+{
+    const __m128i group = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    __m128i v0, v1, v2, v3;
+    __m128i t0, t1, t2, t3;
+
+    v0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(lut + 0)), group);
+    v1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(lut + 4)), group);
+    v2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(lut + 8)), group);
+    v3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(lut + 12)), group);
+    t0 = _mm_unpacklo_epi32(v0, v1);
+    t1 = _mm_unpacklo_epi32(v2, v3);
+    t2 = _mm_unpackhi_epi32(v0, v1);
+    t3 = _mm_unpackhi_epi32(v2, v3);
+    planes[0] = _mm_unpacklo_epi64(t0, t1); // B
+    planes[1] = _mm_unpackhi_epi64(t0, t1); // G
+    planes[2] = _mm_unpacklo_epi64(t2, t3); // R
+    planes[3] = _mm_unpackhi_epi64(t2, t3); // A
+    return;
+}
+
+// 16 indices below 16 to 16 ARGB pixels
+__attribute__((target("ssse3")))
+static inline void lut_store_ssse3(const __m128i* planes, __m128i idx, uint32_t* out)
+{
+    __m128i b, g, r, a;
+    __m128i bg, ra;
+
+    b = _mm_shuffle_epi8(planes[0], idx);
+    g = _mm_shuffle_epi8(planes[1], idx);
+    r = _mm_shuffle_epi8(planes[2], idx);
+    a = _mm_shuffle_epi8(planes[3], idx);
+
+    bg = _mm_unpacklo_epi8(b, g);
+    ra = _mm_unpacklo_epi8(r, a);
+    _mm_storeu_si128((__m128i*)(out + 0), _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi16(bg, ra));
+    bg = _mm_unpackhi_epi8(b, g);
+    ra = _mm_unpackhi_epi8(r, a);
+    _mm_storeu_si128((__m128i*)(out + 8), _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128((__m128i*)(out + 12), _mm_unpackhi_epi16(bg, ra));
+    return;
+}
+
+__attribute__((target("ssse3")))
+static void expand_i2_ssse3(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i bits = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+        (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i planes[4];
+    int i;
+
+    lut_planes_ssse3(lut, planes);
+    for (i = 0; i + 16 <= count; i += 16) {
+        uint16_t t;
+        __m128i v;
+
+        memcpy(&t, data + (i >> 3), sizeof(t));
+        v = _mm_shuffle_epi8(_mm_cvtsi32_si128(t), spread);
+        v = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(v, bits), bits), one);
+        lut_store_ssse3(planes, v, out + i);
+    }
+    expand_tail(data, i, count, lut, out, 1);
+    return;
+}
+
+__attribute__((target("ssse3")))
+static void expand_i4_ssse3(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+    const __m128i m0 = _mm_set1_epi32(0x00000003);
+    const __m128i m1 = _mm_set1_epi32(0x00000300);
+    const __m128i m2 = _mm_set1_epi32(0x00030000);
+    const __m128i m3 = _mm_set1_epi32(0x03000000);
+    __m128i planes[4];
+    int i;
+
+    lut_planes_ssse3(lut, planes);
+    for (i = 0; i + 16 <= count; i += 16) {
+        uint32_t t;
+        __m128i v, idx;
+
+        // byte k of each group keeps bits 7-2k..6-2k, the mask drops what
+        // the 16-bit shift pulls in from the next byte
+        memcpy(&t, data + (i >> 2), sizeof(t));
+        v = _mm_shuffle_epi8(_mm_cvtsi32_si128((int)t), spread);
+        idx = _mm_and_si128(_mm_srli_epi16(v, 6), m0);
+        idx = _mm_or_si128(idx, _mm_and_si128(_mm_srli_epi16(v, 4), m1));
+        idx = _mm_or_si128(idx, _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+        idx = _mm_or_si128(idx, _mm_and_si128(v, m3));
+        lut_store_ssse3(planes, idx, out + i);
+    }
+    expand_tail(data, i, count, lut, out, 2);
+    return;
+}
+
+__attribute__((target("ssse3")))
+static void expand_i16_ssse3(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    const __m128i low = _mm_set1_epi8(0x0F);
+    __m128i planes[4];
+    int i;
+
+    lut_planes_ssse3(lut, planes);
+    for (i = 0; i + 32 <= count; i += 32) {
+        __m128i v, hi, lo;
+
+        v = _mm_loadu_si128((const __m128i*)(data + (i >> 1)));
+        hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+        lo = _mm_and_si128(v, low);
+        lut_store_ssse3(planes, _mm_unpacklo_epi8(hi, lo), out + i);
+        lut_store_ssse3(planes, _mm_unpackhi_epi8(hi, lo), out + i + 16);
+    }
+    expand_tail(data, i, count, lut, out, 4);
+    return;
+}
+
+// VPERMD picks 8 colors straight from lut[0..7] by the low 3 bits of each lane
+__attribute__((target("avx2")))
+static void expand_i2_avx2(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    const __m256i shifts = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i colors;
+    int i;
+
+    colors = _mm256_loadu_si256((const __m256i*)lut);
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m256i idx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(data[i >> 3]), shifts), one);
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_permutevar8x32_epi32(colors, idx));
+    }
+    expand_tail(data, i, count, lut, out, 1);
+    return;
+}
+
+__attribute__((target("avx2")))
+static void expand_i4_avx2(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    const __m256i shifts = _mm256_setr_epi32(6, 4, 2, 0, 14, 12, 10, 8);
+    const __m256i mask = _mm256_set1_epi32(0x3);
+    __m256i colors;
+    int i;
+
+    colors = _mm256_loadu_si256((const __m256i*)lut);
+    for (i = 0; i + 8 <= count; i += 8) {
+        uint16_t t;
+        __m256i idx;
+
+        memcpy(&t, data + (i >> 2), sizeof(t));
+        idx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(t), shifts), mask);
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_permutevar8x32_epi32(colors, idx));
+    }
+    expand_tail(data, i, count, lut, out, 2);
+    return;
+}
+
+// two VPERMD, bit 3 of the index picks the half
+__attribute__((target("avx2")))
+static void expand_i16_avx2(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    const __m256i shifts = _mm256_setr_epi32(4, 0, 12, 8, 20, 16, 28, 24);
+    const __m256i mask = _mm256_set1_epi32(0xF);
+    __m256i colors_lo, colors_hi;
+    int i;
+
+    colors_lo = _mm256_loadu_si256((const __m256i*)lut);
+    colors_hi = _mm256_loadu_si256((const __m256i*)(lut + 8));
+    for (i = 0; i + 8 <= count; i += 8) {
+        uint32_t t;
+        __m256i idx, lo, hi;
+
+        memcpy(&t, data + (i >> 1), sizeof(t));
+        idx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)t), shifts), mask);
+        lo = _mm256_permutevar8x32_epi32(colors_lo, idx);
+        hi = _mm256_permutevar8x32_epi32(colors_hi, idx);
+        lo = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi),
+            _mm256_castsi256_ps(_mm256_slli_epi32(idx, 28))));
+        _mm256_storeu_si256((__m256i*)(out + i), lo);
+    }
+    expand_tail(data, i, count, lut, out, 4);
+    return;
+}
+
+__attribute__((target("avx2")))
+static void expand_i256_avx2(const uint8_t* data, int count, const uint32_t* lut, uint32_t* out)
+{
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(data + i)));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_i32gather_epi32((const int*)lut, idx, 4));
+    }
+    for (; i < count; i++) {
+        out[i] = lut[data[i]];
+    }
+    return;
+}
+#endif
+
+// bits per pixel of the packed formats, 0 for RLE
+static inline int texture_packed_bits(uint16_t encode_format)
+{
+    switch (encode_format) {
+    case ENCODE_FORMAT_I2:
+        return 1;
+    case ENCODE_FORMAT_I4:
+        return 2;
+    case ENCODE_FORMAT_I16:
+        return 4;
+    case ENCODE_FORMAT_I256:
+        return 8;
+    }
+    return 0;
+}
+
+// the kernels read lut[0..15] whatever the format, out of range indices are transparent
+static void texture_build_lut(const uint32_t* colors, int total, uint32_t* lut)
+{
+    int n;
+
+    n = total < 256 ? total : 256;
+    if (n < 0 || !colors)
+        n = 0;
+    memcpy(lut, colors, n * sizeof(uint32_t));
+    memset(lut + n, 0, (256 - n) * sizeof(uint32_t));
+    return;
+}
+
+static inline void fill32(uint32_t* out, uint32_t color, int count)
+{
+    int i = 0;
+
+#if defined(TEXTURE_HAVE_SIMD) && defined(__SSE2__)
+    __m128i v = _mm_set1_epi32((int)color);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(out + i), v);
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = color;
+    }
+    return;
+}
+
+// clears pixels [from, w * h) of a w * h image with rows stride pixels apart
+static void texture_clear_tail(uint32_t* out, int w, int h, int stride, int from)
 {
-    // Overflow!
-    if (index >= size)
+    int y;
+    int x;
+
+    if (stride == w) {
+        memset(out + from, 0, (size_t)(w * h - from) * sizeof(uint32_t));
         return;
+    }
 
-    arr[index] = val;
+    y = from / w;
+    x = from % w;
+    for (; y < h; y++) {
+        memset(out + y * stride + x, 0, (w - x) * sizeof(uint32_t));
+        x = 0;
+    }
     return;
 }
 
-void* texture_load(const uint8_t* data, int data_len, uint16_t encode_format, const palette_t* palette, int w, int h, void* user_data)
+// n pixels from pixel start on, the kernel takes over once start is byte aligned
+static inline void expand_span(expand_fn expand, const uint8_t* data, int bits, int start, int n, const uint32_t* lut, uint32_t* out)
 {
-    void* res;
+    int per_byte = 8 / bits;
+    int mask = (1 << bits) - 1;
+    int head;
+
+    head = (per_byte - start % per_byte) % per_byte;
+    if (head > n)
+        head = n;
+    for (int k = 0; k < head; k++) {
+        int i = start + k;
+        out[k] = lut[(data[i / per_byte] >> (8 - bits * (i % per_byte + 1))) & mask];
+    }
+    expand(data + (start + head) / per_byte, n - head, lut, out + head);
+    return;
+}
+
+// packed formats, the bound is checked once here instead of per pixel.
+// pixels the data does not cover are cleared
+static void texture_decode_packed(const uint8_t* data, int data_len, int bits, const uint32_t* lut, int w, int h, uint32_t* out, int stride)
+{
+    int count;
+    expand_fn expand;
+
+    count = w * h;
+    if (data_len < (count * bits + 7) / 8)
+        count = data_len * (8 / bits);
+
+    switch (bits) {
+    case 1:
+        expand = expand_i2;
+        break;
+    case 2:
+        expand = expand_i4;
+        break;
+    case 4:
+        expand = expand_i16;
+        break;
+    default:
+        expand = expand_i256;
+        break;
+    }
+
+    if (stride == w) {
+        expand(data, count, lut, out);
+    } else {
+        for (int y = 0; y * w < count; y++) {
+            int n = count - y * w < w ? count - y * w : w;
+            expand_span(expand, data, bits, y * w, n, lut, out + y * stride);
+        }
+    }
+    texture_clear_tail(out, w, h, stride, count);
+    return;
+}
+
+static void texture_unpack_indices(const uint8_t* data, int data_len, int bits, int w, int h, uint8_t* out)
+{
+    int count;
+    int per_byte;
+    int mask;
+
+    count = w * h;
+    if (data_len < (count * bits + 7) / 8)
+        count = data_len * (8 / bits);
+
+    if (bits == 8) {
+        memcpy(out, data, count);
+        return;
+    }
+
+    per_byte = 8 / bits;
+    mask = (1 << bits) - 1;
+    for (int i = 0; i < count; i++) {
+        out[i] = (data[i / per_byte] >> (8 - bits * (i % per_byte + 1))) & mask;
+    }
+    return;
+}
+
+// runs may cross rows when the output has a pitch
+static inline void rle_fill(void* out, int indexed, int w, int stride, int pos, int n, int color_index, uint32_t color)
+{
+    while (n > 0) {
+        int x = pos % w;
+        int seg = w - x < n ? w - x : n;
+        int at = (pos / w) * stride + x;
+
+        if (indexed)
+            memset((uint8_t*)out + at, color_index, seg);
+        else
+            fill32((uint32_t*)out + at, color, seg);
+        pos += seg;
+        n -= seg;
+    }
+    return;
+}
+
+static inline void rle_copy(void* out, int indexed, int w, int stride, int pos, int n, const uint8_t* src, const uint32_t* lut)
+{
+    while (n > 0) {
+        int x = pos % w;
+        int seg = w - x < n ? w - x : n;
+        int at = (pos / w) * stride + x;
+
+        if (indexed)
+            memcpy((uint8_t*)out + at, src, seg);
+        else
+            expand_i256(src, seg, lut, (uint32_t*)out + at);
+        src += seg;
+        pos += seg;
+        n -= seg;
+    }
+    return;
+}
+
+// F64: the low 6 bits are the index, the top 2 its run length less one
+// F127: 0..127 is one pixel of that index, 128 + n repeats the next byte n times
+// F256: 0..127 repeats the next byte that many times, 128 + n copies n literal bytes
+// each run is clamped to the output once, then filled or copied as a whole.
+// returns -1 when the data ends inside a run before the output is full,
+// else the ARGB pixels after the data are cleared
+static inline int texture_decode_rle(const uint8_t* data, int data_len, uint16_t encode_format, const uint32_t* lut, int w, int h, int stride, void* out, int indexed)
+{
+    int i;
+    int pos;
+    int count;
+
+    count = w * h;
+    i = 0;
+    pos = 0;
+    while (i < data_len && pos < count) {
+        int n;
+        int head = data[i++];
+
+        if (encode_format == ENCODE_FORMAT_I64RLE) {
+            n = (head >> 6) + 1;
+            if (n > count - pos)
+                n = count - pos;
+            rle_fill(out, indexed, w, stride, pos, n, head & 0x3F, indexed ? 0 : lut[head & 0x3F]);
+            pos += n;
+            continue;
+        }
+
+        if (encode_format == ENCODE_FORMAT_I127RLE && head <= 127) {
+            int at = (pos / w) * stride + pos % w;
+
+            if (indexed)
+                ((uint8_t*)out)[at] = (uint8_t)head;
+            else
+                ((uint32_t*)out)[at] = lut[head];
+            pos++;
+            continue;
+        }
+
+        if (encode_format == ENCODE_FORMAT_I127RLE || head <= 127) {
+            int color_index;
+
+            if (i >= data_len)
+                return -1;
+            color_index = data[i++];
+            n = encode_format == ENCODE_FORMAT_I127RLE ? head - 128 : head;
+            if (n > count - pos)
+                n = count - pos;
+            rle_fill(out, indexed, w, stride, pos, n, color_index, indexed ? 0 : lut[color_index]);
+            pos += n;
+            continue;
+        }
+
+        // a literal run cut short by the end of the data copies what is there
+        n = head - 128;
+        if (n > data_len - i)
+            n = data_len - i;
+        if (n > count - pos)
+            n = count - pos;
+        rle_copy(out, indexed, w, stride, pos, n, data + i, lut);
+        pos += n;
+        i += head - 128;
+    }
+
+    // the data ran out inside a run before every pixel got one
+    if (i > data_len && pos < count)
+        return -1;
+
+    if (!indexed)
+        texture_clear_tail((uint32_t*)out, w, h, stride, pos);
+    return 0;
+}
+
+// 0 on success, -1 for an unknown format, -2 for truncated RLE data
+static int texture_decode_lut(const uint8_t* data, int data_len, uint16_t encode_format, const uint32_t* lut, int w, int h, uint32_t* out, int stride)
+{
+    int bits;
+
+    bits = texture_packed_bits(encode_format);
+    if (bits) {
+        texture_decode_packed(data, data_len, bits, lut, w, h, out, stride);
+        return 0;
+    }
+
+    switch (encode_format) {
+    case ENCODE_FORMAT_I64RLE:
+    case ENCODE_FORMAT_I127RLE:
+    case ENCODE_FORMAT_I256RLE:
+        if (texture_decode_rle(data, data_len, encode_format, lut, w, h, stride, out, 0))
+            return -2;
+        return 0;
+    }
+    return -1;
+}
+
+// 16-bit texels from their words, in place when dst is src with pitch w * 2
+static void texture_narrow_rows(const uint32_t* src, int w, int h, uint8_t* dst, int pitch)
+{
+    for (int y = 0; y < h; y++) {
+        const uint32_t* s = src + y * w;
+        uint16_t* d = (uint16_t*)(dst + y * pitch);
+
+        for (int x = 0; x < w; x++) {
+            d[x] = (uint16_t)s[x];
+        }
+    }
+    return;
+}
 
-    size_t cur_pos;
+// TEX_ALPHA_* of w * h words with alpha on top
+static int texture_alpha_rows(const uint32_t* pixels, int w, int h, int stride)
+{
+    uint32_t any = 0;
+    uint32_t all = 0xFF;
+    uint32_t mid = 0;
+
+    for (int y = 0; y < h; y++) {
+        const uint32_t* src = pixels + y * stride;
+
+        for (int x = 0; x < w; x++) {
+            uint32_t a = src[x] >> 24;
+
+            any |= a;
+            all &= a;
+            // 0 for alpha 0 and 255 only
+            mid |= (a + 1) & 0xFE;
+        }
+    }
+    if (!any)
+        return TEX_ALPHA_EMPTY;
+    if (all == 0xFF)
+        return TEX_ALPHA_OPAQUE;
+    return mid ? TEX_ALPHA_BLEND : TEX_ALPHA_KEYED;
+}
+
+// tight box of the pixels with alpha, w * h pixels that are not empty
+static void texture_bounds(const uint32_t* pixels, int w, int h, texture_info_t* info)
+{
+    int x0, x1, y0, y1;
+
+    y0 = 0;
+    while (y0 < h - 1 && texture_alpha_rows(pixels + y0 * w, w, 1, w) == TEX_ALPHA_EMPTY)
+        y0++;
+    y1 = h;
+    while (y1 > y0 + 1 && texture_alpha_rows(pixels + (y1 - 1) * w, w, 1, w) == TEX_ALPHA_EMPTY)
+        y1--;
+
+    x0 = w;
+    x1 = 0;
+    for (int y = y0; y < y1; y++) {
+        const uint32_t* row = pixels + y * w;
+        int l = 0;
+        int r = w;
+
+        while (l < x0 && !(row[l] >> 24))
+            l++;
+        while (r > x1 && r > l && !(row[r - 1] >> 24))
+            r--;
+        if (l < x0)
+            x0 = l;
+        if (r > x1)
+            x1 = r;
+    }
+    if (x0 >= x1) {
+        x0 = 0;
+        x1 = w;
+    }
+
+    info->x = x0;
+    info->y = y0;
+    info->w = x1 - x0;
+    info->h = y1 - y0;
+    return;
+}
+
+static void texture_pack_mask_rows(const uint32_t* pixels, int w, int h, int stride, uint64_t* out)
+{
+    int words;
+
+    // transparent palette entries decode to alpha 0 (1555 clear bit,
+    // 0565 key 0xF81F, 4444 zero alpha), padding bits stay clear
+    words = TEXTURE_MASK_WORDS(w);
+    memset(out, 0, words * h * sizeof(uint64_t));
+    for (int y = 0; y < h; y++) {
+        const uint32_t* src = pixels + y * stride;
+        uint64_t* row = out + y * words;
+
+        for (int x = 0; x < w; x++) {
+            if (src[x] >> 24)
+                row[x >> 6] |= (uint64_t)1 << (x & 63);
+        }
+    }
+    return;
+}
+
+// public functions
+void texture_init()
+{
+    if (kernels_picked)
+        return;
+    kernels_picked = 1;
+
+#ifdef TEXTURE_HAVE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        expand_i2 = expand_i2_avx2;
+        expand_i4 = expand_i4_avx2;
+        expand_i16 = expand_i16_avx2;
+        expand_i256 = expand_i256_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        expand_i2 = expand_i2_ssse3;
+        expand_i4 = expand_i4_ssse3;
+        expand_i16 = expand_i16_ssse3;
+        return;
+    }
+#endif
+    return;
+}
+
+uint32_t* texture_scratch_get(texture_scratch_t* scratch, int count)
+{
+    uint32_t* pixels;
+
+    if (!scratch || count <= 0)
+        return NULL;
+    if (count <= scratch->capacity)
+        return scratch->pixels;
+
+    // nothing worth keeping, skip the copy realloc would do
+    pixels = (uint32_t*)malloc(count * sizeof(uint32_t));
+    if (!pixels)
+        return NULL;
+    if (scratch->pixels)
+        free(scratch->pixels);
+    scratch->pixels = pixels;
+    scratch->capacity = count;
+    return pixels;
+}
+
+void texture_scratch_free(texture_scratch_t* scratch)
+{
+    if (!scratch)
+        return;
+
+    if (scratch->pixels)
+        free(scratch->pixels);
+    scratch->pixels = NULL;
+    scratch->capacity = 0;
+    return;
+}
+
+int texture_decode_to(const uint8_t* data, int data_len, uint16_t encode_format, const palette_t* palette, int w, int h, uint32_t* out, int pitch)
+{
+    uint32_t lut[256];
+
+    // param check
+    if (!data || !palette || !out || w <= 0 || h <= 0)
+        return -1;
+    if (pitch < w * 4 || (pitch & 3))
+        return -1;
+
+    texture_build_lut(palette->pixel_data, palette->total_pixels, lut);
+    return texture_decode_lut(data, data_len, encode_format, lut, w, h, out, pitch / 4);
+}
+
+uint32_t* texture_decode(const uint8_t* data, int data_len, uint16_t encode_format, const palette_t* palette, int w, int h)
+{
     uint32_t* pixels;
 
     // param check
     if (!data || !palette || w <= 0 || h <= 0)
         return NULL;
 
-    pixels = (uint32_t*)calloc(w * h, sizeof(uint32_t));
+    pixels = (uint32_t*)malloc(w * h * sizeof(uint32_t));
     if (!pixels)
-        goto fail;
+        return NULL;
 
-    cur_pos = 0;
-    switch (encode_format) {
-    // 0002
-    case ENCODE_FORMAT_I2: {
-        for (int i = 0; i < data_len; i++) {
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 7) & 0x1));
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 6) & 0x1));
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 5) & 0x1));
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 4) & 0x1));
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 3) & 0x1));
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 2) & 0x1));
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 1) & 0x1));
-            SAFE_PUT(palette_get_color(palette, data[i] & 0x1));
-        }
-        break;
+    if (texture_decode_to(data, data_len, encode_format, palette, w, h, pixels, w * 4)) {
+        free(pixels);
+        return NULL;
     }
-    // 0004
-    case ENCODE_FORMAT_I4: {
-        for (int i = 0; i < data_len; i++) {
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 6) & 0x3));
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 4) & 0x3));
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 2) & 0x3));
-            SAFE_PUT(palette_get_color(palette, data[i] & 0x3));
-        }
-        break;
+    return pixels;
+}
+
+uint32_t* texture_decode_scratch(const uint8_t* data, int data_len, uint16_t encode_format, const palette_t* palette, int w, int h, texture_scratch_t* scratch)
+{
+    uint32_t* pixels;
+
+    // param check
+    if (!data || !palette || w <= 0 || h <= 0)
+        return NULL;
+
+    pixels = texture_scratch_get(scratch, w * h);
+    if (!pixels)
+        return NULL;
+
+    if (texture_decode_to(data, data_len, encode_format, palette, w, h, pixels, w * 4))
+        return NULL;
+    return pixels;
+}
+
+uint8_t* texture_decode_indices(const uint8_t* data, int data_len, uint16_t encode_format, int w, int h)
+{
+    int bits;
+    uint8_t* indices;
+
+    // param check
+    if (!data || w <= 0 || h <= 0)
+        return NULL;
+
+    bits = texture_packed_bits(encode_format);
+    if (!bits && encode_format != ENCODE_FORMAT_I64RLE && encode_format != ENCODE_FORMAT_I127RLE && encode_format != ENCODE_FORMAT_I256RLE)
+        return NULL;
+
+    // palettes hold at most 255 colors, so 0xFF never maps to a color
+    // and stays transparent like the zeroed ARGB buffer
+    indices = (uint8_t*)malloc(w * h);
+    if (!indices)
+        return NULL;
+    memset(indices, TEXTURE_INDEX_NONE, w * h);
+
+    if (bits) {
+        texture_unpack_indices(data, data_len, bits, w, h, indices);
+        return indices;
     }
-    // 0016
-    case ENCODE_FORMAT_I16: {
-        for (int i = 0; i < data_len; i++) {
-            SAFE_PUT(palette_get_color(palette, (data[i] >> 4) & 0xF));
-            SAFE_PUT(palette_get_color(palette, data[i] & 0xF));
+    if (texture_decode_rle(data, data_len, encode_format, NULL, w, h, w, indices, 1)) {
+        free(indices);
+        return NULL;
+    }
+    return indices;
+}
+
+int texture_index_usage(const uint8_t* data, int data_len, uint16_t encode_format, int w, int h, uint64_t* used)
+{
+    int i;
+    int bits;
+    int pos;
+    int count;
+
+    if (!data || !used || w <= 0 || h <= 0)
+        return -1;
+
+    memset(used, 0, TEXTURE_USAGE_WORDS * sizeof(uint64_t));
+    count = w * h;
+    bits = texture_packed_bits(encode_format);
+    if (bits) {
+        int per_byte = 8 / bits;
+        int mask = (1 << bits) - 1;
+        int bytes = (count + per_byte - 1) / per_byte;
+
+        if (bytes > data_len)
+            bytes = data_len;
+        for (i = 0; i < bytes; i++) {
+            int n = count - i * per_byte < per_byte ? count - i * per_byte : per_byte;
+
+            for (int k = 0; k < n; k++) {
+                int index = (data[i] >> (8 - bits * (k + 1))) & mask;
+                used[index >> 6] |= (uint64_t)1 << (index & 63);
+            }
         }
+        return 0;
+    }
+
+    switch (encode_format) {
+    case ENCODE_FORMAT_I64RLE:
+    case ENCODE_FORMAT_I127RLE:
+    case ENCODE_FORMAT_I256RLE:
         break;
+    default:
+        return -1;
     }
-    // 0256
-    case ENCODE_FORMAT_I256: {
-        for (int i = 0; i < data_len; i++) {
-            uint32_t color_tmp = palette_get_color(palette, data[i]);
-            SAFE_PUT(color_tmp);
+
+    // same walk as texture_decode_rle, runs only add their index
+    i = 0;
+    pos = 0;
+    while (i < data_len && pos < count) {
+        int n;
+        int head = data[i++];
+
+        if (encode_format == ENCODE_FORMAT_I64RLE) {
+            used[(head & 0x3F) >> 6] |= (uint64_t)1 << (head & 0x3F);
+            pos += (head >> 6) + 1;
+            continue;
         }
-        break;
+
+        if (encode_format == ENCODE_FORMAT_I127RLE && head <= 127) {
+            used[head >> 6] |= (uint64_t)1 << (head & 63);
+            pos++;
+            continue;
+        }
+
+        if (encode_format == ENCODE_FORMAT_I127RLE || head <= 127) {
+            if (i >= data_len)
+                return -2;
+            n = encode_format == ENCODE_FORMAT_I127RLE ? head - 128 : head;
+            if (n)
+                used[data[i] >> 6] |= (uint64_t)1 << (data[i] & 63);
+            i++;
+            pos += n;
+            continue;
+        }
+
+        n = head - 128;
+        if (n > count - pos)
+            n = count - pos;
+        for (int k = 0; k < n && i + k < data_len; k++) {
+            used[data[i + k] >> 6] |= (uint64_t)1 << (data[i + k] & 63);
+        }
+        if (head - 128 > data_len - i)
+            return -2;
+        pos += n;
+        i += head - 128;
     }
-    // F127
-    case ENCODE_FORMAT_I127RLE: {
-        for (int i = 0; i < data_len; i++) {
-            uint32_t color_tmp;
-            int index_tmp = data[i];
-            if (index_tmp <= 127) {
-                SAFE_PUT(palette_get_color(palette, index_tmp));
-                continue;
-            }
+    return 0;
+}
 
-            index_tmp -= 128;
-            color_tmp = palette_get_color(palette, data[++i]);
-            while (index_tmp-- > 0) {
-                SAFE_PUT(color_tmp);
-            }
+int texture_expand(const uint8_t* indices, int count, const palette_t* palette, uint32_t* out)
+{
+    int n;
+    uint8_t used[256];
+    uint32_t lut[256];
+
+    if (!indices || !palette || !out)
+        return TEX_ALPHA_UNKNOWN;
+
+    // out of range indices read as transparent, no check per pixel
+    texture_build_lut(palette->texel_data, palette->total_pixels, lut);
+    memset(used, 0, sizeof(used));
+    if (TEX_FORMAT_BYTES(palette->texel_format) == 2) {
+        uint16_t* texels = (uint16_t*)out;
+
+        for (int i = 0; i < count; i++) {
+            texels[i] = (uint16_t)lut[indices[i]];
+            used[indices[i]] = 1;
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            out[i] = lut[indices[i]];
+            used[indices[i]] = 1;
         }
-        break;
     }
-    // F256
-    case ENCODE_FORMAT_I256RLE: {
-        for (int i = 0; i < data_len; i++) {
-            int index_tmp = data[i];
-            if (index_tmp <= 127) {
-                uint32_t color_tmp = palette_get_color(palette, data[++i]);
-                while (index_tmp-- > 0) {
-                    SAFE_PUT(color_tmp);
-                }
-                continue;
-            }
 
-            index_tmp -= 128;
-            while (index_tmp-- > 0) {
-                SAFE_PUT(palette_get_color(palette, data[++i]));
-            }
+    // the class only depends on which colors show up, lut keeps alpha on top
+    n = 0;
+    for (int i = 0; i < 256; i++) {
+        if (used[i])
+            lut[n++] = lut[i];
+    }
+    return texture_alpha_rows(lut, n, 1, n);
+}
+
+void texture_to_texels(uint32_t* pixels, int count, int tex_format)
+{
+    uint16_t* texels;
+
+    if (!pixels || tex_format == TEX_FORMAT_ARGB8888)
+        return;
+
+    if (TEX_FORMAT_BYTES(tex_format) == 4) {
+        for (int i = 0; i < count; i++) {
+            pixels[i] = palette_color_to_texel(pixels[i], tex_format);
         }
-        break;
+        return;
     }
-    // Unsupported format
-    default:
-        goto fail;
+
+    // word i is read before texel i lands on its lower half
+    texels = (uint16_t*)pixels;
+    for (int i = 0; i < count; i++) {
+        texels[i] = (uint16_t)palette_color_to_texel(pixels[i], tex_format);
     }
+    return;
+}
 
-    res = module_new(pixels, w, h, user_data);
+int texture_pick_format(const tex_op_t* tex_op, void* user_data, uint16_t pixel_format)
+{
+    int formats;
+
+    formats = TEX_FORMAT_ARGB8888;
+    if (tex_op && tex_op->module_formats)
+        formats = tex_op->module_formats(user_data);
+
+    // 16-bit sources keep their size when nothing is lost on the way
+    if (pixel_format == PIXEL_FORMAT_4444 && (formats & TEX_FORMAT_ARGB4444))
+        return TEX_FORMAT_ARGB4444;
+    if (pixel_format == PIXEL_FORMAT_1555 && (formats & TEX_FORMAT_ARGB1555))
+        return TEX_FORMAT_ARGB1555;
+    if (!(formats & TEX_FORMAT_ARGB8888) && (formats & TEX_FORMAT_ABGR8888))
+        return TEX_FORMAT_ABGR8888;
+    return TEX_FORMAT_ARGB8888;
+}
+
+int texture_alpha_class(const uint32_t* pixels, int w, int h)
+{
+    if (!pixels || w <= 0 || h <= 0)
+        return TEX_ALPHA_UNKNOWN;
+
+    return texture_alpha_rows(pixels, w, h, w);
+}
+
+void texture_trim(uint32_t* pixels, int w, int h, texture_info_t* info)
+{
+    if (!pixels || !info || w <= 0 || h <= 0)
+        return;
+
+    texture_bounds(pixels, w, h, info);
+    if (info->w == w && info->h == h)
+        return;
+
+    // rows only move towards the start
+    for (int y = 0; y < info->h; y++) {
+        memmove(pixels + y * info->w, pixels + (info->y + y) * w + info->x, info->w * sizeof(uint32_t));
+    }
+    return;
+}
+
+void texture_pack_mask(const uint32_t* pixels, int w, int h, uint64_t* out)
+{
+    if (!pixels || !out || w <= 0 || h <= 0)
+        return;
+
+    texture_pack_mask_rows(pixels, w, h, w, out);
+    return;
+}
+
+void* texture_load(const uint8_t* data, int data_len, uint16_t encode_format, const palette_t* palette, int w, int h, const tex_op_t* tex_op, void* user_data, uint64_t* mask, int trim, texture_info_t* info, texture_scratch_t* scratch)
+{
+    void* res;
+    int format;
+    int klass;
+    uint32_t* pixels;
+    uint32_t lut[256];
+    texture_info_t local;
+
+    // param check
+    if (!data || !palette || w <= 0 || h <= 0)
+        return NULL;
+
+    if (!info)
+        info = &local;
+    info->alpha = TEX_ALPHA_UNKNOWN;
+    info->x = 0;
+    info->y = 0;
+    info->w = w;
+    info->h = h;
+
+    // the lut holds final texels, alpha stays in the top byte for the mask
+    format = palette->texel_format;
+    texture_build_lut(palette->texel_data, palette->total_pixels, lut);
+
+    if (scratch)
+        pixels = texture_scratch_get(scratch, w * h);
+    else
+        pixels = (uint32_t*)malloc(w * h * sizeof(uint32_t));
+    if (!pixels)
+        return NULL;
+
+    res = NULL;
+    if (texture_decode_lut(data, data_len, encode_format, lut, w, h, pixels, w))
+        goto done;
+    info->alpha = texture_alpha_rows(pixels, w, h, w);
+    if (mask)
+        texture_pack_mask_rows(pixels, w, h, w, mask);
+    // nothing to draw, nothing to upload
+    if (info->alpha == TEX_ALPHA_EMPTY)
+        goto done;
+
+    // opaque modules have no border to drop, the rect that is left may
+    // well be opaque though. info keeps the class of the whole module
+    klass = info->alpha;
+    if (trim && klass != TEX_ALPHA_OPAQUE) {
+        texture_trim(pixels, w, h, info);
+        if (info->w != w || info->h != h)
+            klass = texture_alpha_rows(pixels, info->w, info->h, info->w);
+        w = info->w;
+        h = info->h;
+    }
+
+    // 16-bit texels still have alpha on top, narrow them in place. module_new
+    // copies them out of the scratch buffer, a streaming texture per module
+    // would keep a second copy around on GL
+    if (TEX_FORMAT_BYTES(format) == 2)
+        texture_narrow_rows(pixels, w, h, (uint8_t*)pixels, w * 2);
+    res = tex_op->module_new(pixels, w, h, format, user_data);
+    if (res && tex_op->module_alpha)
+        tex_op->module_alpha(res, klass, user_data);
+
+done:
 #ifdef FREE_PIXEL_DATA
-    free(pixels);
+    if (!scratch)
+        free(pixels);
 #endif
     return res;
-
-fail:
-    if (pixels)
-        free(pixels);
-
-    return NULL;
 }
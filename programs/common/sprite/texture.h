@@ -39,16 +39,138 @@ extern "C" {
 #define ENCODE_FORMAT_I4        0x0400
 #define ENCODE_FORMAT_I16       0x1600
 #define ENCODE_FORMAT_I256      0x5602
+#define ENCODE_FORMAT_I64RLE    0x64F0
 #define ENCODE_FORMAT_I127RLE   0x27F1
 #define ENCODE_FORMAT_I256RLE   0x56F2
 
+// index of pixels the encoded data does not cover
+#define TEXTURE_INDEX_NONE      0xFF
+
+// 64-bit words per row of a 1-bit opacity mask
+#define TEXTURE_MASK_WORDS(w)   (((w) + 63) >> 6)
+
+// 64-bit words of a palette index usage set, bit (i & 63) of word (i >> 6)
+#define TEXTURE_USAGE_WORDS     4
+
+// structs
+
+// decode buffer reused across modules, one per thread that decodes.
+// zero initialised is empty, it grows to the largest module asked for
+typedef struct texture_scratch_s
+{
+    uint32_t *pixels;
+    int capacity; // in pixels
+} texture_scratch_t;
+
+// what texture_load found out about the pixels it decoded
+typedef struct texture_info_s
+{
+    int alpha;      // TEX_ALPHA_*
+    int x, y, w, h; // part of the module that was uploaded, all of it unless trimmed
+} texture_info_t;
+
 // public functions
+
+// picks the decode kernels of the CPU, plain C ones decode until then. call it
+// before decoding on more than one thread, sprite_load_custom does
+void texture_init();
+
+// count pixels of scratch memory, contents are left as they were
+uint32_t* texture_scratch_get(texture_scratch_t *scratch, int count);
+void      texture_scratch_free(texture_scratch_t *scratch);
+
+// decode into a malloc'ed w * h ARGB buffer, caller frees it
+uint32_t* texture_decode(const uint8_t *data,
+                    int data_len,
+                    uint16_t encode_format,
+                    const palette_t *palette,
+                    int w, int h);
+
+// decode into caller memory with rows pitch bytes apart, pixels the data
+// does not cover are cleared. 0 on success
+int texture_decode_to(const uint8_t *data,
+                    int data_len,
+                    uint16_t encode_format,
+                    const palette_t *palette,
+                    int w, int h,
+                    uint32_t *out,
+                    int pitch);
+
+// decode into scratch memory, valid until its next use
+uint32_t* texture_decode_scratch(const uint8_t *data,
+                    int data_len,
+                    uint16_t encode_format,
+                    const palette_t *palette,
+                    int w, int h,
+                    texture_scratch_t *scratch);
+
+// decode into a malloc'ed w * h buffer of palette indices, caller frees it
+uint8_t* texture_decode_indices(const uint8_t *data,
+                    int data_len,
+                    uint16_t encode_format,
+                    int w, int h);
+
+// set the bits of the palette indices the encoded pixels use, without
+// decoding them. 0 on success, on failure used is only a partial set
+int texture_index_usage(const uint8_t *data,
+                    int data_len,
+                    uint16_t encode_format,
+                    int w, int h,
+                    uint64_t *used);
+
+// apply palette to count indices, out gets texels of palette->texel_format
+// (2 bytes each for the 16-bit formats). returns the TEX_ALPHA_* of the result
+int texture_expand(const uint8_t *indices,
+                    int count,
+                    const palette_t *palette,
+                    uint32_t *out);
+
+// TEX_ALPHA_* of w * h ARGB pixels
+int texture_alpha_class(const uint32_t *pixels,
+                    int w, int h);
+
+// drop fully transparent rows and columns around w * h ARGB pixels, the
+// kept rect is packed to the start of pixels and written to info
+void texture_trim(uint32_t *pixels,
+                    int w, int h,
+                    texture_info_t *info);
+
+// pack w * h ARGB pixels into h rows of TEXTURE_MASK_WORDS(w) words,
+// bit (x & 63) of word (x >> 6) is set when pixel x has alpha
+void texture_pack_mask(const uint32_t *pixels,
+                    int w, int h,
+                    uint64_t *out);
+
+// count ARGB pixels to tex_format in place, 16-bit texels end up packed
+// at the start of the buffer
+void texture_to_texels(uint32_t *pixels,
+                    int count,
+                    int tex_format);
+
+// TEX_FORMAT_* modules of a palette with pixel_format are made in, from what
+// the backend lists: 16-bit when the source converts without loss, else 32-bit
+int texture_pick_format(const tex_op_t *tex_op,
+                    void *user_data,
+                    uint16_t pixel_format);
+
+// decode to texels of palette->texel_format and make a module of them.
+// mask is optional, when set it receives the opacity of the decoded pixels.
+// info is optional too and gets the TEX_ALPHA_* of the pixels, no module is
+// made for TEX_ALPHA_EMPTY ones. with trim set only the rect in info is
+// uploaded, the mask still covers all w * h pixels.
+// pixels decode into scratch and go to module_new, without scratch into a
+// temporary buffer per call
 void* texture_load(const uint8_t *data,
                     int data_len,
                     uint16_t encode_format,
                     const palette_t *palette,
                     int w, int h,
-                    void *user_data);
+                    const tex_op_t *tex_op,
+                    void *user_data,
+                    uint64_t *mask,
+                    int trim,
+                    texture_info_t *info,
+                    texture_scratch_t *scratch);
 
 #ifdef __cplusplus
 }